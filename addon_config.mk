@@ -63,3 +63,10 @@ common:
 	# osx/iOS only, any framework that should be included in the project
 	ADDON_FRAMEWORKS = CoreMidi
 
+linux64:
+	# RtMidi uses the ALSA sequencer on linux
+	ADDON_PKG_CONFIG_LIBRARIES = alsa
+
+linux:
+	# RtMidi uses the ALSA sequencer on linux
+	ADDON_PKG_CONFIG_LIBRARIES = alsa
@@ -0,0 +1,47 @@
+#include "Benchmarks.h"
+
+#include <cstdlib>
+
+/*
+
+The benchmarks of example-benchmark, against TwisterCore alone, with 
+TwisterValues bound - no openFrameworks needed. Built by the CMake 
+build at the top of the addon, and run as a test there:
+
+	twister_core_benchmark [messages per storm]
+
+*/
+
+using namespace pal::Kontrol;
+
+namespace {
+
+// ------------------------------------------------------
+// a TwisterCore, with params_ TwisterValues bound.
+
+BenchmarkRig makeRig(size_t params_) {
+	auto values = std::make_shared<std::vector<TwisterValue>>(params_);
+	std::vector<TwisterParam> params;
+	for (size_t i = 0; i < params_; ++i) {
+		params.push_back((*values)[i].param("benchmark/p" + std::to_string(i)));
+	}
+
+	auto twister = std::make_shared<TwisterCore>();
+	twister->setup(RtMidi::LOOPBACK);
+	twister->setParams(std::move(params));
+
+	BenchmarkRig rig;
+	bindRig(rig, twister);
+	rig.setParam = [values](size_t i_, float v_) { (*values)[i_].set(v_); };
+	return rig;
+}
+
+} // close anonymous namespace
+
+//========================================================================
+int main(int argc, char** argv) {
+	const size_t messages = argc > 1 ? size_t(std::strtoull(argv[1], nullptr, 10)) : 500000;
+
+	runBenchmarks(&makeRig, messages);
+	return 0;
+}
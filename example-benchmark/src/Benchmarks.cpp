@@ -0,0 +1,278 @@
+#include "Benchmarks.h"
+
+#include <thread>
+
+using namespace pal::Kontrol;
+
+namespace {
+
+const std::string kPortName       = "Midi Fighter Twister"; ///< a std::string, so that inject() does not allocate
+const size_t      kChunk          = 64;  ///< messages injected between calls to update()
+const uint64_t    kDrainTimeoutNs = 10000000000ULL;
+const size_t      kFrames         = 10000;
+
+// ------------------------------------------------------
+
+// rotary controller messages, round robin over encoders_ controllers,
+// with values that change on every message.
+std::vector<std::array<uint8_t, 3>> makeStorm(size_t count_, size_t encoders_) {
+	std::vector<std::array<uint8_t, 3>> storm(count_);
+	for (size_t i = 0; i < count_; ++i) {
+		storm[i] = { { 0xB0, uint8_t(i % encoders_), uint8_t((i / encoders_) & 0x7F) } };
+	}
+	return storm;
+}
+
+// ------------------------------------------------------
+
+void inject(const std::array<uint8_t, 3>& m_) {
+	// the loopback ring is full if delivery falls behind - wait.
+	while (!RtMidiLoopback::inject(kPortName, m_.data(), m_.size())) {
+		std::this_thread::yield();
+	}
+}
+
+// ------------------------------------------------------
+
+std::atomic<uint64_t> gDelivered{ 0 };
+
+void countMessages(const RtMidiMessage *, unsigned int count_, void *) {
+	gDelivered.fetch_add(count_, std::memory_order_relaxed);
+}
+
+// ------------------------------------------------------
+// RtMidi alone: loopback input thread delivering to a callback
+// which only counts.
+
+Measurement benchRtMidi(size_t messages_) {
+	Measurement result;
+	result.stage = "rtmidi";
+
+	RtMidiIn in(RtMidi::LOOPBACK);
+	for (unsigned int i = 0; i < in.getPortCount(); ++i) {
+		if (in.getPortName(i) == kPortName)
+			in.openPort(i);
+	}
+	in.setBatchCallback(&countMessages, nullptr);
+
+	auto storm = makeStorm(messages_, 16);
+	gDelivered = 0;
+
+	const uint64_t allocs = allocationCount();
+	Stopwatch t;
+	for (const auto& m : storm) {
+		inject(m);
+	}
+	while (gDelivered < storm.size() && t.elapsedNs() < kDrainTimeoutNs) {
+		std::this_thread::yield();
+	}
+	result.ns          = t.elapsedNs();
+	result.allocations = allocationCount() - allocs;
+	result.messages    = gDelivered;
+
+	in.closePort();
+	return result;
+}
+
+// ------------------------------------------------------
+// the midi callback, which translates messages and hands them over
+// to the thread channel - reached through injectInput(), on this 
+// thread, with update() draining the channel untimed in between - 
+// and the thread channel on its own, a batch sent and received.
+
+std::vector<Measurement> benchCallback(size_t messages_) {
+	Measurement callback;
+	callback.stage = "callback";
+	Measurement channel;
+	channel.stage = "channel";
+
+	std::vector<RtMidiMessage> storm(messages_);
+	auto bytes = makeStorm(messages_, 16);
+	for (size_t i = 0; i < messages_; ++i) {
+		storm[i].assign(bytes[i].data(), bytes[i].size());
+	}
+
+	// no ports, and nothing bound: update() only drains.
+	TwisterCore twister;
+
+	for (size_t i = 0; i < storm.size(); i += kChunk) {
+		const unsigned int count = unsigned(std::min(kChunk, storm.size() - i));
+
+		const uint64_t allocs = threadAllocationCount();
+		Stopwatch t;
+		twister.injectInput(&storm[i], count);
+		callback.ns          += t.elapsedNs();
+		callback.allocations += threadAllocationCount() - allocs;
+		callback.messages    += count;
+
+		twister.update();
+	}
+
+	ThreadChannel<MidiCCBatch> queue(1);
+	MidiCCBatch batch;
+	MidiCCBatch received;
+
+	for (size_t i = 0; i < messages_; i += kChunk) {
+		batch.count = std::min(kChunk, messages_ - i);
+
+		const uint64_t allocs = threadAllocationCount();
+		Stopwatch t;
+		queue.send(batch);
+		queue.tryReceive(received);
+		channel.ns          += t.elapsedNs();
+		channel.allocations += threadAllocationCount() - allocs;
+		channel.messages    += received.count;
+	}
+
+	return { callback, channel };
+}
+
+// ------------------------------------------------------
+// the whole input path, with encoders_ float parameters bound.
+// "update" is the time spent in update(), on this thread -
+// dispatch, response curve, setting the parameter and its listeners,
+// which includes the addon sending the value back to the device.
+// "pipeline" is the wall time from the first message injected
+// to the last one handled, and counts allocations on all threads.
+//
+// the twister binds 16 encoders at a time: with 64 parameters, the
+// storm covers all four banks, and only the first bank is applied.
+//
+// with trackLatency_, the same runs with latency tracking on, and
+// logs the latency histograms.
+
+std::vector<Measurement> benchPipeline(const BenchmarkRigFactory& makeRig_, size_t messages_, size_t encoders_, bool trackLatency_ = false) {
+	Measurement update;
+	update.stage = trackLatency_ ? "update+lat" : "update";
+	update.encoders = encoders_;
+	Measurement pipeline;
+	pipeline.stage = trackLatency_ ? "pipeline+lat" : "pipeline";
+	pipeline.encoders = encoders_;
+
+	auto storm = makeStorm(messages_, encoders_);
+
+	BenchmarkRig rig = makeRig_(encoders_);
+	rig.setLatencyTracking(trackLatency_);
+
+	// all messages are handled once update() has taken them all.
+	auto handled = [&rig, messages_]() {
+		const auto stats = rig.getStats();
+		return stats.received[0] == messages_ && stats.queued == 0;
+	};
+
+	const uint64_t allocs = allocationCount();
+	Stopwatch t;
+
+	auto timedUpdate = [&]() {
+		const uint64_t a = threadAllocationCount();
+		Stopwatch u;
+		rig.update();
+		update.ns          += u.elapsedNs();
+		update.allocations += threadAllocationCount() - a;
+	};
+
+	for (size_t i = 0; i < storm.size(); i += kChunk) {
+		for (size_t j = i; j < std::min(i + kChunk, storm.size()); ++j) {
+			inject(storm[j]);
+		}
+		timedUpdate();
+	}
+	while (!handled() && t.elapsedNs() < kDrainTimeoutNs) {
+		timedUpdate();
+	}
+
+	pipeline.ns          = t.elapsedNs();
+	pipeline.allocations = allocationCount() - allocs;
+	pipeline.messages    = storm.size();
+	update.messages      = storm.size();
+
+	const auto stats = rig.getStats();
+	if (!handled()) {
+		TwisterLog(TWISTER_LOG_WARNING, "benchmark") << encoders_ << " encoders: handled " << stats.received[0] - stats.queued << " of " << messages_ << " messages";
+	}
+	TwisterLog(TWISTER_LOG_NOTICE, "benchmark") << encoders_ << " encoders: "
+		<< stats.dropped << " dropped, " << stats.dispatched << " dispatched, " << stats.coalesced << " coalesced, "
+		<< stats.ignored << " ignored, " << stats.outOfRange << " out of range, "
+		<< stats.sent << " sent, queue high water " << stats.queueHighWater;
+
+	if (trackLatency_) {
+		rig.logLatency();
+	}
+
+	return { update, pipeline };
+}
+
+// ------------------------------------------------------
+// the output path: our code writes params_ bound float parameters
+// changes_ times per frame, and each change goes out through the
+// parameter listener, Encoder::setValue, sendToRotary and
+// RtMidiOut::sendMessage. a frame ends with update(), as in an app.
+//
+// as above, only the first 16 parameters are bound.
+
+FrameMeasurement benchOutput(const BenchmarkRigFactory& makeRig_, size_t params_, size_t changes_) {
+	FrameMeasurement result;
+	result.params  = params_;
+	result.changes = changes_;
+	result.frames  = kFrames;
+
+	BenchmarkRig rig = makeRig_(params_);
+
+	const uint64_t sends  = RtMidiLoopback::sentCount(kPortName);
+	const uint64_t bytes  = RtMidiLoopback::sentBytes(kPortName);
+	const uint64_t allocs = threadAllocationCount();
+	Stopwatch t;
+
+	for (size_t frame = 0; frame < kFrames; ++frame) {
+		for (size_t c = 0; c < changes_; ++c) {
+			// a different midi value on every change
+			const float v = ((frame * changes_ + c) % 128) / 127.f;
+			for (size_t p = 0; p < params_; ++p) {
+				rig.setParam(p, v);
+			}
+		}
+		rig.update();
+	}
+
+	result.ns          = t.elapsedNs();
+	result.allocations = threadAllocationCount() - allocs;
+	result.sends       = RtMidiLoopback::sentCount(kPortName) - sends;
+	result.bytes       = RtMidiLoopback::sentBytes(kPortName) - bytes;
+	return result;
+}
+
+} // close anonymous namespace
+
+// ------------------------------------------------------
+
+void runBenchmarks(const BenchmarkRigFactory& makeRig_, size_t messages_) {
+
+	// no echo, so that input only ever comes from us, and no
+	// capture, so that output does not pile up.
+	RtMidiLoopback::createPort(kPortName, false, false);
+
+	std::vector<Measurement> input;
+	input.push_back(benchRtMidi(messages_));
+	for (auto& m : benchCallback(messages_)) {
+		input.push_back(m);
+	}
+	for (size_t encoders : { 1, 16, 64 }) {
+		for (auto& m : benchPipeline(makeRig_, messages_, encoders)) {
+			input.push_back(m);
+		}
+	}
+	for (auto& m : benchPipeline(makeRig_, messages_, 16, true)) {
+		input.push_back(m);
+	}
+	report("input: rotary controller storm", input);
+
+	std::vector<FrameMeasurement> output;
+	for (size_t params : { 1, 16, 64 }) {
+		for (size_t changes : { 1, 8 }) {
+			output.push_back(benchOutput(makeRig_, params, changes));
+		}
+	}
+	report("output: parameter changes per frame", output);
+
+	RtMidiLoopback::removePort(kPortName);
+}
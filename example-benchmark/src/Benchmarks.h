@@ -0,0 +1,42 @@
+#pragma once
+
+#include "Measure.h"
+#include "TwisterCore.h"
+
+#include <functional>
+#include <memory>
+
+/*
+
+The benchmarks, written against TwisterCore, so that they run both
+in the openFrameworks app, with ofParameters bound, and in the core
+benchmark (see core/main.cpp), with TwisterValues bound.
+
+*/
+
+// a twister, set up against the loopback port, with a number of
+// float parameters bound - as the app under test sees it.
+struct BenchmarkRig {
+	std::function<void()>                 update;   ///< the app's update(), once per frame
+	std::function<void(size_t, float)>    setParam; ///< change parameter i from code
+
+	std::function<pal::Kontrol::TwisterStats::Snapshot()> getStats;
+	std::function<void(bool)>                             setLatencyTracking;
+	std::function<void()>                                 logLatency;
+};
+
+// fills in the rig's twister calls for t_, which may be a TwisterCore
+// or an ofxParameterTwister.
+template <typename T>
+void bindRig(BenchmarkRig& rig_, const std::shared_ptr<T>& t_) {
+	rig_.update             = [t_]() { t_->update(); };
+	rig_.getStats           = [t_]() { return t_->getStats(); };
+	rig_.setLatencyTracking = [t_](bool enabled_) { t_->setLatencyTracking(enabled_); };
+	rig_.logLatency         = [t_]() { t_->logLatency(); };
+}
+
+typedef std::function<BenchmarkRig(size_t params_)> BenchmarkRigFactory;
+
+// run all benchmarks, and log their results. messages_ is the size
+// of the controller message storms.
+void runBenchmarks(const BenchmarkRigFactory& makeRig_, size_t messages_ = 500000);
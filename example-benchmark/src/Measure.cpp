@@ -0,0 +1,84 @@
+#include "Measure.h"
+
+#include "TwisterLog.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+using namespace pal::Kontrol;
+
+namespace {
+std::atomic<uint64_t> gAllocations{ 0 };
+thread_local uint64_t tAllocations = 0;
+} // close anonymous namespace
+
+// ------------------------------------------------------
+// every allocation in the process goes through here, so that
+// benchmarks can tell how many allocations a stage makes.
+// array new and the other deletes forward to these.
+
+void* operator new(std::size_t size_) {
+	gAllocations.fetch_add(1, std::memory_order_relaxed);
+	++tAllocations;
+	if (void* p = std::malloc(size_ ? size_ : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p_) noexcept {
+	std::free(p_);
+}
+
+void operator delete(void* p_, std::size_t) noexcept {
+	std::free(p_);
+}
+
+// ------------------------------------------------------
+
+uint64_t allocationCount() {
+	return gAllocations.load(std::memory_order_relaxed);
+}
+
+// ------------------------------------------------------
+
+uint64_t threadAllocationCount() {
+	return tAllocations;
+}
+
+// ------------------------------------------------------
+
+void report(const std::string& title_, const std::vector<Measurement>& measurements_) {
+	TwisterLog(TWISTER_LOG_NOTICE, "benchmark") << title_;
+
+	char line[160];
+	std::snprintf(line, sizeof(line), "%-13s %8s %10s %14s %10s %12s",
+		"stage", "encoders", "messages", "messages/s", "ns/msg", "allocs/msg");
+	TwisterLog(TWISTER_LOG_NOTICE, "benchmark") << line;
+
+	for (const auto& m : measurements_) {
+		std::snprintf(line, sizeof(line), "%-13s %8zu %10llu %14.0f %10.1f %12.3f",
+			m.stage.c_str(), m.encoders, (unsigned long long)m.messages,
+			m.messagesPerSecond(), m.nsPerMessage(), m.allocationsPerMessage());
+		TwisterLog(TWISTER_LOG_NOTICE, "benchmark") << line;
+	}
+}
+
+// ------------------------------------------------------
+
+void report(const std::string& title_, const std::vector<FrameMeasurement>& measurements_) {
+	TwisterLog(TWISTER_LOG_NOTICE, "benchmark") << title_;
+
+	char line[160];
+	std::snprintf(line, sizeof(line), "%8s %8s %8s %10s %12s %12s %12s",
+		"params", "changes", "frames", "us/frame", "sends/frame", "bytes/frame", "allocs/frame");
+	TwisterLog(TWISTER_LOG_NOTICE, "benchmark") << line;
+
+	for (const auto& m : measurements_) {
+		std::snprintf(line, sizeof(line), "%8zu %8zu %8llu %10.2f %12.1f %12.1f %12.1f",
+			m.params, m.changes, (unsigned long long)m.frames,
+			m.usPerFrame(), m.sendsPerFrame(), m.bytesPerFrame(), m.allocationsPerFrame());
+		TwisterLog(TWISTER_LOG_NOTICE, "benchmark") << line;
+	}
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+
+Tools for the benchmarks: a stopwatch, and a count of all heap 
+allocations made by the process - see Measure.cpp, which replaces
+the global operator new.
+
+*/
+
+// heap allocations so far, on all threads, 
+// or on the calling thread only.
+uint64_t allocationCount();
+uint64_t threadAllocationCount();
+
+struct Stopwatch {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	uint64_t elapsedNs() const {
+		return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	}
+};
+
+// what one run of a benchmark stage cost.
+struct Measurement {
+	std::string stage;
+	size_t   encoders    = 0; ///< bound encoders, 0 where it does not apply
+	uint64_t messages    = 0;
+	uint64_t ns          = 0;
+	uint64_t allocations = 0;
+
+	double messagesPerSecond() const { return ns ? messages * 1e9 / ns : 0.; }
+	double nsPerMessage() const { return messages ? double(ns) / messages : 0.; }
+	double allocationsPerMessage() const { return messages ? double(allocations) / messages : 0.; }
+};
+
+// what a run of frames cost, on the output side.
+struct FrameMeasurement {
+	size_t   params      = 0; ///< bound parameters changed per frame
+	size_t   changes     = 0; ///< times each parameter changes per frame
+	uint64_t frames      = 0;
+	uint64_t ns          = 0;
+	uint64_t sends       = 0; ///< midi messages sent
+	uint64_t bytes       = 0; ///< midi bytes sent
+	uint64_t allocations = 0;
+
+	double usPerFrame() const { return frames ? ns * 1e-3 / frames : 0.; }
+	double sendsPerFrame() const { return frames ? double(sends) / frames : 0.; }
+	double bytesPerFrame() const { return frames ? double(bytes) / frames : 0.; }
+	double allocationsPerFrame() const { return frames ? double(allocations) / frames : 0.; }
+};
+
+// log a table of measurements.
+void report(const std::string& title_, const std::vector<Measurement>& measurements_);
+void report(const std::string& title_, const std::vector<FrameMeasurement>& measurements_);
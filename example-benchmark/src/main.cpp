@@ -0,0 +1,13 @@
+#include "ofMain.h"
+#include "ofAppNoWindow.h"
+#include "ofApp.h"
+
+//========================================================================
+int main( ){
+	// benchmarks don't draw, so we run without a window.
+	ofAppNoWindow window;
+	ofSetupOpenGL(&window, 0, 0, OF_WINDOW);
+
+	ofRunApp(new ofApp());
+
+}
@@ -0,0 +1,44 @@
+#include "ofApp.h"
+
+#include "Benchmarks.h"
+#include "ofxParameterTwister.h"
+
+using namespace pal::Kontrol;
+
+namespace {
+
+// ------------------------------------------------------
+// an ofxParameterTwister, with params_ ofParameter<float>s bound.
+
+BenchmarkRig makeRig(size_t params_) {
+	auto params = std::make_shared<std::vector<ofParameter<float>>>(params_);
+	ofParameterGroup group;
+	group.setName("benchmark");
+	for (size_t i = 0; i < params_; ++i) {
+		(*params)[i].set("p" + ofToString(i), 0.f, 0.f, 1.f);
+		group.add((*params)[i]);
+	}
+
+	auto twister = std::make_shared<ofxParameterTwister>();
+	twister->setup(RtMidi::LOOPBACK);
+	twister->setParams(group);
+
+	BenchmarkRig rig;
+	bindRig(rig, twister);
+	rig.setParam = [params](size_t i_, float v_) { (*params)[i_].set(v_); };
+	return rig;
+}
+
+} // close anonymous namespace
+
+//--------------------------------------------------------------
+void ofApp::setup(){
+	ofSetLogLevel(OF_LOG_NOTICE);
+
+	runBenchmarks(&makeRig);
+}
+
+//--------------------------------------------------------------
+void ofApp::update(){
+	ofExit();
+}
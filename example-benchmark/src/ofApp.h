@@ -0,0 +1,36 @@
+#pragma once
+
+#include "ofMain.h"
+
+/*
+
+Benchmarks for ofxParameterTwister, run against in-process loopback 
+midi ports (see RtMidiLoopback), so that no device is needed.
+
+The input benchmark drives storms of rotary controller messages 
+through the same path device input takes - RtMidi's input thread, 
+the midi callback, the thread channel, update(), and ofParameter::set -
+and logs messages/s, ns/message and heap allocations/message for 
+each stage, with 1, 16 and 64 bound parameters - and once more with latency 
+tracking on, logging the latency histograms.
+
+The output benchmark changes bound parameters from code, a number 
+of times per frame, and logs wall time, midi messages and bytes sent,
+and heap allocations per frame.
+
+Results are logged; the app quits once all benchmarks have run.
+
+The benchmarks themselves are in Benchmarks.cpp, which does not 
+depend on openFrameworks: core/main.cpp runs the same benchmarks
+against TwisterCore alone, from the CMake build at the top of the 
+addon.
+
+*/
+
+class ofApp : public ofBaseApp{
+
+	public:
+		void setup();
+		void update();
+
+};
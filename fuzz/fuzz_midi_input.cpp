@@ -0,0 +1,162 @@
+/*
+
+Fuzz target for the midi input path: decoding in the midi callback,
+coalescing, dispatch to the encoders, parameters and events, and the
+sends which parameter changes cause.
+
+The input is read as a stream of midi messages, each one a length
+byte (0..15, the low nibble) followed by that many bytes, so that
+the fuzzer reaches running status, truncated, oversized and garbled
+messages, and sysex. The first byte also picks the page, and whether
+pickup is on.
+
+The harness runs against TwisterCore, so it needs no openFrameworks.
+The CMake build at the top of the addon builds it - with libFuzzer 
+if the compiler is clang and TWISTER_LIBFUZZER is on:
+
+	CXX=clang++ cmake -S . -B build -DTWISTER_LIBFUZZER=ON
+	cmake --build build --target fuzz_midi_input
+	build/fuzz_midi_input corpus/
+
+otherwise standalone, for AFL, or to replay inputs: the program then 
+runs each file given as argument, or stdin, as one input - or, with
+--random n, n pseudo-random inputs, as the build's smoke test does.
+
+*/
+
+#include "TwisterCore.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <random>
+
+using namespace pal::Kontrol;
+
+namespace {
+
+struct Target {
+	// more parameters than encoders, so that there are pages, and
+	// both parameter types.
+	std::vector<TwisterValue> floats{ 24 };
+	std::vector<TwisterValue> bools{ 8 };
+
+	TwisterCore twister;
+
+	size_t events = 0;
+
+	Target() {
+		setTwisterLogLevel(TWISTER_LOG_SILENT);
+
+		std::vector<TwisterParam> params;
+		for (size_t i = 0; i < floats.size(); ++i) {
+			floats[i].set(0.5f);
+			params.push_back(floats[i].param("fuzz/f" + std::to_string(i)));
+			if (i % 4 == 0) {
+				params.push_back(bools[i / 4].param("fuzz/b" + std::to_string(i / 4), 0.f, 1.f, TwisterParam::Type::BOOL));
+			}
+		}
+
+		// no loopback port exists, so output finds no port.
+		twister.setup(RtMidi::LOOPBACK);
+		twister.setParams(std::move(params));
+
+		twister.setEventHandler([this](const TwisterEvent&) {
+			++events;
+		});
+		twister.bindAction(TwisterEvent::Type::SIDE_BUTTON_PRESS, 0, [this]() {
+			twister.nextPage();
+		});
+	}
+};
+
+} // close anonymous namespace
+
+// ------------------------------------------------------
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data_, size_t size_) {
+	static Target target;
+
+	if (size_ == 0)
+		return 0;
+
+	// ----------| invariant: there is a first byte
+
+	const uint8_t flags = data_[0];
+	target.twister.setPage(flags & 0x03);
+	target.twister.setPickupMode("fuzz/f0", (flags & 0x04) != 0);
+
+	std::vector<RtMidiMessage> messages;
+	for (size_t pos = 1; pos < size_;) {
+		const size_t len = std::min<size_t>(data_[pos] & 0x0F, size_ - pos - 1);
+		RtMidiMessage m;
+		m.assign(data_ + pos + 1, unsigned(len));
+		m.timeNs = pos;
+		messages.push_back(m);
+		pos += 1 + len;
+	}
+
+	if (!messages.empty()) {
+		target.twister.injectInput(messages.data(), unsigned(messages.size()));
+	}
+	target.twister.update();
+
+	// every value must have stayed within its parameter's range.
+	for (size_t i = 0; i < target.floats.size(); ++i) {
+		const float v = target.floats[i].get();
+		if (!(v >= 0.f && v <= 1.f)) {
+			std::fprintf(stderr, "parameter f%zu out of range: %f\n", i, v);
+			std::abort();
+		}
+	}
+
+	return 0;
+}
+
+// ------------------------------------------------------
+
+#if defined(TWISTER_FUZZ_MAIN)
+namespace {
+
+int runInput(std::istream& in_) {
+	std::vector<uint8_t> input{ std::istreambuf_iterator<char>(in_), std::istreambuf_iterator<char>() };
+	return LLVMFuzzerTestOneInput(input.data(), input.size());
+}
+
+} // close anonymous namespace
+
+// ------------------------------------------------------
+
+int main(int argc, char** argv) {
+	if (argc > 2 && std::strcmp(argv[1], "--random") == 0) {
+		// a fixed seed, so that a failure can be reproduced.
+		std::mt19937 rng(1);
+		const unsigned long runs = std::strtoul(argv[2], nullptr, 10);
+		for (unsigned long r = 0; r < runs; ++r) {
+			// mostly controller messages, so that input gets past decoding.
+			std::vector<uint8_t> input{ uint8_t(rng()) };
+			for (size_t m = rng() % 512; m > 0; --m) {
+				if (rng() % 4) {
+					input.insert(input.end(), { 3, uint8_t(0xB0 | rng() % 5), uint8_t(rng() % 128), uint8_t(rng() % 128) });
+				} else {
+					input.push_back(uint8_t(rng()));
+				}
+			}
+			LLVMFuzzerTestOneInput(input.data(), input.size());
+		}
+		return 0;
+	}
+
+	if (argc == 1) {
+		return runInput(std::cin);
+	}
+	for (int i = 1; i < argc; ++i) {
+		std::ifstream file(argv[i], std::ios::binary);
+		runInput(file);
+	}
+	return 0;
+}
+#endif
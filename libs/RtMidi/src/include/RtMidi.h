@@ -45,10 +45,17 @@
 
 #define RTMIDI_VERSION "2.1.0"
 
-#ifndef __MACOSX_CORE__
-#define __WINDOWS_MM__
+#if !defined(__MACOSX_CORE__) && !defined(__LINUX_ALSA__) && !defined(__UNIX_JACK__) && !defined(__WINDOWS_MM__) && !defined(__RTMIDI_DUMMY__)
+  #if defined(__linux__)
+    #define __LINUX_ALSA__
+  #else
+    #define __WINDOWS_MM__
+  #endif
 #endif
 
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
 #include <exception>
 #include <iostream>
 #include <string>
@@ -117,6 +124,79 @@ typedef void (*RtMidiErrorCallback)( RtMidiError::Type type, const std::string &
 
 class MidiApi;
 
+/************************************************************************/
+/*! \struct RtMidiMessage
+    \brief A single MIDI message, as held by the RtMidiIn input queue.
+
+    Messages of up to three bytes (all channel and system common
+    messages) are stored inline, so that the common path never touches
+    the allocator.  Only longer messages (sysex) use heap storage, which
+    is kept and reused once it has been allocated.
+
+    A message may also be a view of bytes owned by the API (see
+    view()), which is how long sysex messages reach callbacks without
+    being copied.  Copying a message always makes an owning copy.
+*/
+/************************************************************************/
+
+struct RtMidiMessage
+{
+  enum { INLINE_SIZE = 3 };
+
+  //! Time stamp, as delta time in seconds since the previous message.
+  double timeStamp;
+
+  //! Absolute time stamp, in nanoseconds on the std::chrono::steady_clock time base, or 0 if unknown.
+  /*!
+    Unlike timeStamp, this does not accumulate drift when summed, and
+    can be compared directly with std::chrono::steady_clock::now().
+    Each API takes it from the most precise source it has: ALSA and
+    JACK event times, CoreMIDI host time stamps; WinMM stamps messages
+    on arrival.
+  */
+  uint64_t timeNs;
+
+  RtMidiMessage() : timeStamp( 0.0 ), timeNs( 0 ), external_( 0 ), size_( 0 ) {}
+
+  RtMidiMessage( const RtMidiMessage &other )
+    : timeStamp( other.timeStamp ), timeNs( other.timeNs ), external_( 0 ), size_( 0 ) { assign( other.data(), other.size() ); }
+
+  RtMidiMessage &operator=( const RtMidiMessage &other );
+
+  //! Returns a pointer to the message bytes.
+  const unsigned char *data( void ) const { return external_ ? external_ : size_ > INLINE_SIZE ? &heap_[0] : inline_; }
+
+  //! Returns the number of message bytes.
+  unsigned int size( void ) const { return size_; }
+
+  //! Returns the last message byte; the message must not be empty.
+  unsigned char back( void ) const { return data()[size_ - 1]; }
+
+  //! Removes all bytes, but keeps any heap storage for reuse.
+  void clear( void ) { external_ = 0; size_ = 0; heap_.clear(); }
+
+  //! Replaces the message bytes.
+  void assign( const unsigned char *bytes, unsigned int nBytes );
+
+  //! Appends to the message bytes, moving them to heap storage if needed.
+  void append( const unsigned char *bytes, unsigned int nBytes );
+
+  void push_back( unsigned char byte ) { append( &byte, 1 ); }
+
+  //! Makes the message a view of \e nBytes bytes owned elsewhere, without copying them.
+  /*!
+    The bytes must remain valid, and unchanged, for as long as the
+    message refers to them.
+  */
+  void view( const unsigned char *bytes, unsigned int nBytes ) { external_ = bytes; size_ = nBytes; }
+
+ private:
+  const unsigned char *external_;
+  unsigned char inline_[INLINE_SIZE];
+  unsigned int size_;
+  std::vector<unsigned char> heap_;
+};
+
 class RtMidi
 {
  public:
@@ -128,7 +208,8 @@ class RtMidi
     LINUX_ALSA,     /*!< The Advanced Linux Sound Architecture API. */
     UNIX_JACK,      /*!< The JACK Low-Latency MIDI Server API. */
     WINDOWS_MM,     /*!< The Microsoft Multimedia MIDI API. */
-    RTMIDI_DUMMY    /*!< A compilable but non-functional API. */
+    RTMIDI_DUMMY,   /*!< A compilable but non-functional API. */
+    LOOPBACK        /*!< An in-process loopback bus, for testing and benchmarking (see RtMidiLoopback).  Only used when asked for explicitly. */
   };
 
   //! A static function to determine the current RtMidi version.
@@ -214,6 +295,25 @@ class RtMidiIn : public RtMidi
   //! User callback function type definition.
   typedef void (*RtMidiCallback)( double timeStamp, std::vector<unsigned char> *message, void *userData);
 
+  //! User callback function type definition, for callbacks which receive message bytes as pointer and length.
+  /*!
+    The message bytes are only valid for the duration of the call.
+    Unlike RtMidiCallback, this never copies message bytes into an
+    std::vector, so that the common path never touches the allocator.
+  */
+  typedef void (*RtMidiRawCallback)( double timeStamp, const unsigned char *message, size_t size, void *userData );
+
+  //! User callback function type definition, for callbacks which receive messages in batches.
+  /*!
+    APIs which can read several messages per wakeup (ALSA) hand them to
+    the callback in one call; other APIs call it with one message at a
+    time.  The messages are only valid for the duration of the call.
+  */
+  typedef void (*RtMidiBatchCallback)( const RtMidiMessage *messages, unsigned int count, void *userData );
+
+  //! A clock, returning the current time in nanoseconds - see setTimeSource().
+  typedef uint64_t (*RtMidiTimeSource)( void *userData );
+
   //! Default constructor that allows an optional api, client name and queue size.
   /*!
     An exception will be thrown if a MIDI system initialization
@@ -275,6 +375,18 @@ class RtMidiIn : public RtMidi
   */
   void setCallback( RtMidiCallback callback, void *userData = 0 );
 
+  //! Set a callback function which receives message bytes as pointer and length.
+  /*!
+    \sa setCallback( RtMidiCallback, void * ), RtMidiRawCallback
+  */
+  void setRawCallback( RtMidiRawCallback callback, void *userData = 0 );
+
+  //! Set a callback function which receives messages in batches.
+  /*!
+    \sa setCallback( RtMidiCallback, void * ), RtMidiBatchCallback
+  */
+  void setBatchCallback( RtMidiBatchCallback callback, void *userData = 0 );
+
   //! Cancel use of the current callback function (if one exists).
   /*!
     Subsequent incoming MIDI messages will be written to the queue
@@ -311,6 +423,62 @@ class RtMidiIn : public RtMidi
   */
   void ignoreTypes( bool midiSysex = true, bool midiTime = true, bool midiSense = true );
 
+  //! MIDI event types, which may be combined into a mask for setEventTypeFilter().
+  enum EventType {
+    EVENT_NOTE             = 0x01, /*!< Note on, note off, polyphonic key pressure. */
+    EVENT_CONTROLLER       = 0x02, /*!< Control change. */
+    EVENT_PROGRAM          = 0x04, /*!< Program change. */
+    EVENT_CHANNEL_PRESSURE = 0x08, /*!< Channel pressure. */
+    EVENT_PITCHBEND        = 0x10, /*!< Pitch bend. */
+    EVENT_SYSEX            = 0x20, /*!< System exclusive. */
+    EVENT_SYSTEM           = 0x40, /*!< System common and realtime: time code, song position, clock, start/stop, active sensing, reset. */
+    EVENT_ALL              = 0x7F  /*!< All of the above. */
+  };
+
+  //! Receive only the MIDI event types in the \e types mask (a combination of EventType values).
+  /*!
+    With the ALSA API, the filter is installed on the sequencer
+    client, so that the sequencer drops all other events (including
+    port subscription notifications) before they reach the input
+    thread.  Other APIs ignore the filter.  Passing EVENT_ALL, or 0,
+    removes the filter.  ignoreTypes() still applies on top of the
+    filter.
+  */
+  void setEventTypeFilter( unsigned int types = EVENT_ALL );
+
+  //! Stamp this input's messages (RtMidiMessage::timeNs) with \e source, rather than with std::chrono::steady_clock.
+  /*!
+    Only the LOOPBACK API stamps messages itself; other APIs take their
+    stamps from the system, and ignore the time source.  The time
+    source applies to this input only, and takes precedence over the
+    one set with RtMidiLoopback::setTimeSource().  It is called on
+    whichever thread injects or echoes a message.  Passing a null \e
+    source restores the default.
+  */
+  void setTimeSource( RtMidiTimeSource source, void *userData = 0 );
+
+  //! Scheduling policy of the input thread, as reported by getThreadPolicy().
+  enum ThreadPolicy {
+    THREAD_UNSPECIFIED, /*!< The API does not run its own input thread, or no port has been opened yet. */
+    THREAD_NORMAL,      /*!< The input thread uses the default time-sharing policy. */
+    THREAD_REALTIME     /*!< The input thread uses a realtime (SCHED_FIFO) policy. */
+  };
+
+  //! Request realtime scheduling for the input thread.
+  /*!
+    This applies to APIs which run their own input thread (ALSA), and
+    takes effect the next time a port is opened.  \e priority is
+    clamped to the range permitted for SCHED_FIFO.  If \e cpu is not
+    negative, the input thread is also pinned to that CPU.  If the
+    system does not permit realtime scheduling, a warning is issued and
+    the thread is started with the default policy; use
+    getThreadPolicy() to find out which policy is in effect.
+  */
+  void setRealtimeScheduling( bool enable, int priority = 80, int cpu = -1 );
+
+  //! Return the effective scheduling policy of the input thread, and optionally its priority.
+  ThreadPolicy getThreadPolicy( int *priority = 0 );
+
   //! Fill the user-provided vector with the data bytes for the next available MIDI message in the input queue and return the event delta-time in seconds.
   /*!
     This function returns immediately whether a new message is
@@ -321,6 +489,12 @@ class RtMidiIn : public RtMidi
   */
   double getMessage( std::vector<unsigned char> *message );
 
+  //! Same as getMessage( std::vector<unsigned char> * ), also returning the message's absolute time stamp in \e timeNs.
+  /*!
+    \sa RtMidiMessage::timeNs
+  */
+  double getMessage( std::vector<unsigned char> *message, uint64_t *timeNs );
+
   //! Set an error callback function to be invoked when an error has occured.
   /*!
     The callback function will be called whenever an error has occured. It is best
@@ -412,6 +586,31 @@ class RtMidiOut : public RtMidi
   */
   void sendMessage( std::vector<unsigned char> *message );
 
+  //! Immediately send \e size bytes, a single message, out an open MIDI output port.
+  /*!
+      The bytes are copied into a buffer which the port reuses, so
+      that, once the buffer has grown to the largest message, sending
+      does not allocate.  An exception is thrown if an error occurs
+      during output or an output connection was not previously
+      established.
+  */
+  void sendMessage( const unsigned char *message, size_t size );
+
+  //! Send a single message out an open MIDI output port, \e delay seconds from now.
+  /*!
+      With the ALSA API, the message is timestamped and scheduled on a
+      sequencer queue, which delivers it at the requested time without
+      any further involvement of the caller; messages may be scheduled
+      in any order.  Other APIs issue a debug warning and send the
+      message immediately.  An exception is thrown if an error occurs
+      during output or an output connection was not previously
+      established.
+  */
+  void scheduleMessage( std::vector<unsigned char> *message, double delay );
+
+  //! Discard all scheduled messages which have not been sent yet.
+  void cancelScheduledMessages( void );
+
   //! Set an error callback function to be invoked when an error has occured.
   /*!
     The callback function will be called whenever an error has occured. It is best
@@ -424,6 +623,71 @@ class RtMidiOut : public RtMidi
 };
 
 
+/************************************************************************/
+/*! \class RtMidiLoopback
+    \brief Ports of the in-process loopback API.
+
+    The RtMidi::LOOPBACK API connects RtMidiIn and RtMidiOut instances
+    to named ports which live in memory, within the current process.
+    This allows all MIDI input and output paths of an application to
+    be run without any hardware, or MIDI system, present.
+
+    Each port has two directions.  Messages injected into a port
+    (standing in for a device) are delivered to every RtMidiIn which
+    has the port open, by a delivery thread per RtMidiIn, exactly like
+    a system API delivers them.  Messages sent by an RtMidiOut to a
+    port are captured, so that they can be inspected, and optionally
+    echoed back to the port's inputs.
+
+    Injection is meant to happen from one thread at a time.
+*/
+/************************************************************************/
+
+class RtMidiLoopback
+{
+ public:
+
+  //! Create a port, which then shows up in the port lists of the LOOPBACK API.
+  /*!
+    If \e echo is true, messages sent to the port are also delivered
+    to its inputs.  If \e capture is false, sent messages are only
+    counted, not stored.  Creating a port which exists already
+    changes its options.
+  */
+  static void createPort( const std::string &name, bool echo = false, bool capture = true );
+
+  //! Remove a port; inputs and outputs which have it open no longer receive, or send, anything.
+  static void removePort( const std::string &name );
+
+  //! Deliver a message to all inputs which have the port open, as if it came from a device.  Returns false if the port does not exist, or an input's ring is full.
+  static bool inject( const std::string &name, const unsigned char *message, size_t size );
+
+  //! Deliver a message to all inputs which have the port open, as if it came from a device.
+  static bool inject( const std::string &name, const std::vector<unsigned char> &message ) { return inject( name, message.empty() ? 0 : &message[0], message.size() ); }
+
+  //! Return, and forget, the messages sent to a port so far.
+  static std::vector< std::vector<unsigned char> > capture( const std::string &name );
+
+  //! Return the number of messages sent to a port so far, whether captured or not.
+  static unsigned long long sentCount( const std::string &name );
+
+  //! Return the number of bytes sent to a port so far, whether captured or not.
+  static unsigned long long sentBytes( const std::string &name );
+
+  //! A clock, returning the current time in nanoseconds.
+  typedef RtMidiIn::RtMidiTimeSource TimeSource;
+
+  //! Stamp injected and echoed messages (RtMidiMessage::timeNs) with \e source, rather than with std::chrono::steady_clock.
+  /*!
+    This lets tests run the loopback API on a virtual clock, so that
+    timestamps are reproducible.  The time source is shared by all
+    loopback inputs which have no time source of their own (see
+    RtMidiIn::setTimeSource()).  Passing a null \e source restores
+    the steady clock.
+  */
+  static void setTimeSource( TimeSource source, void *userData = 0 );
+};
+
 // **************************************************************** //
 //
 // MidiInApi / MidiOutApi class declarations.
@@ -473,31 +737,48 @@ class MidiInApi : public MidiApi
   MidiInApi( unsigned int queueSizeLimit );
   virtual ~MidiInApi( void );
   void setCallback( RtMidiIn::RtMidiCallback callback, void *userData );
+  void setRawCallback( RtMidiIn::RtMidiRawCallback callback, void *userData );
+  void setBatchCallback( RtMidiIn::RtMidiBatchCallback callback, void *userData );
   void cancelCallback( void );
   virtual void ignoreTypes( bool midiSysex, bool midiTime, bool midiSense );
-  double getMessage( std::vector<unsigned char> *message );
+  virtual void setEventTypeFilter( unsigned int types );
+  virtual void setTimeSource( RtMidiIn::RtMidiTimeSource source, void *userData );
+  void setRealtimeScheduling( bool enable, int priority, int cpu );
+  RtMidiIn::ThreadPolicy getThreadPolicy( int *priority );
+  double getMessage( std::vector<unsigned char> *message, uint64_t *timeNs = 0 );
 
   // A MIDI structure used internally by the class to store incoming
   // messages.  Each message represents one and only one MIDI message.
-  struct MidiMessage { 
-    std::vector<unsigned char> bytes; 
-    double timeStamp;
-
-    // Default constructor.
-  MidiMessage()
-  :bytes(0), timeStamp(0.0) {}
-  };
-
+  typedef RtMidiMessage MidiMessage;
+
+  // A single-producer (the API's input thread), single-consumer
+  // (getMessage) ring buffer.  The producer owns "back", the consumer
+  // owns "front"; each publishes its own index with release semantics
+  // and reads the other's with acquire semantics, so no locks are
+  // needed.  One slot always stays empty to tell a full ring from an
+  // empty one, so ringSize is one larger than the queue size limit.
   struct MidiQueue {
-    unsigned int front;
-    unsigned int back;
-    unsigned int size;
+    std::atomic<unsigned int> front;
+    std::atomic<unsigned int> back;
     unsigned int ringSize;
     MidiMessage *ring;
 
     // Default constructor.
   MidiQueue()
-  :front(0), back(0), size(0), ringSize(0) {}
+  :front(0), back(0), ringSize(0), ring(0) {}
+
+    // Producer side: returns false if the queue is full.
+    bool push( const MidiMessage &message );
+
+    // Producer side: pushes as many messages as fit, and publishes
+    // them all at once.  Returns the number of messages pushed.
+    unsigned int push( const MidiMessage *messages, unsigned int count );
+
+    // Consumer side: returns false if the queue is empty.
+    bool pop( std::vector<unsigned char> *message, double *timeStamp, uint64_t *timeNs = 0 );
+
+    // Number of queued messages, as seen from the calling thread.
+    unsigned int size( void ) const;
   };
 
   // The RtMidiInData structure is used to pass private class data to
@@ -511,18 +792,40 @@ class MidiInApi : public MidiApi
     void *apiData;
     bool usingCallback;
     RtMidiIn::RtMidiCallback userCallback;
+    RtMidiIn::RtMidiRawCallback rawCallback;
+    RtMidiIn::RtMidiBatchCallback batchCallback;
     void *userData;
     bool continueSysex;
+    std::vector<unsigned char> callbackBytes; // reused for RtMidiCallback
 
     // Default constructor.
   RtMidiInData()
   : ignoreFlags(7), doInput(false), firstMessage(true),
-      apiData(0), usingCallback(false), userCallback(0), userData(0),
-      continueSysex(false) {}
+      apiData(0), usingCallback(false), userCallback(0), rawCallback(0),
+      batchCallback(0), userData(0), continueSysex(false) {}
+
+    // Pass a complete message to the user callback, or push it to the
+    // queue.  Returns false if the queue is full.
+    bool deliver( const MidiMessage &message );
+
+    // Pass complete messages to the user callback, or push them to the
+    // queue.  Returns the number of messages delivered.
+    unsigned int deliver( const MidiMessage *messages, unsigned int count );
   };
 
  protected:
   RtMidiInData inputData_;
+
+  // Input thread scheduling, as requested by the user, and as
+  // reported by the API once its input thread has been started.
+  bool realtime_;
+  int realtimePriority_;
+  int realtimeCpu_;
+  RtMidiIn::ThreadPolicy threadPolicy_;
+  int threadPriority_;
+
+  // Returns true if a callback may be set.
+  bool canSetCallback( bool callbackIsValid );
 };
 
 class MidiOutApi : public MidiApi
@@ -532,6 +835,14 @@ class MidiOutApi : public MidiApi
   MidiOutApi( void );
   virtual ~MidiOutApi( void );
   virtual void sendMessage( std::vector<unsigned char> *message ) = 0;
+  virtual void scheduleMessage( std::vector<unsigned char> *message, double delay );
+  virtual void cancelScheduledMessages( void );
+
+  // Copies into messageBuffer_, and sends that.
+  void sendBytes( const unsigned char *message, size_t size );
+
+ protected:
+  std::vector<unsigned char> messageBuffer_;
 };
 
 // **************************************************************** //
@@ -546,11 +857,18 @@ inline void RtMidiIn :: openVirtualPort( const std::string portName ) { rtapi_->
 inline void RtMidiIn :: closePort( void ) { rtapi_->closePort(); }
 inline bool RtMidiIn :: isPortOpen() const { return rtapi_->isPortOpen(); }
 inline void RtMidiIn :: setCallback( RtMidiCallback callback, void *userData ) { ((MidiInApi *)rtapi_)->setCallback( callback, userData ); }
+inline void RtMidiIn :: setRawCallback( RtMidiRawCallback callback, void *userData ) { ((MidiInApi *)rtapi_)->setRawCallback( callback, userData ); }
+inline void RtMidiIn :: setBatchCallback( RtMidiBatchCallback callback, void *userData ) { ((MidiInApi *)rtapi_)->setBatchCallback( callback, userData ); }
 inline void RtMidiIn :: cancelCallback( void ) { ((MidiInApi *)rtapi_)->cancelCallback(); }
 inline unsigned int RtMidiIn :: getPortCount( void ) { return rtapi_->getPortCount(); }
 inline std::string RtMidiIn :: getPortName( unsigned int portNumber ) { return rtapi_->getPortName( portNumber ); }
 inline void RtMidiIn :: ignoreTypes( bool midiSysex, bool midiTime, bool midiSense ) { ((MidiInApi *)rtapi_)->ignoreTypes( midiSysex, midiTime, midiSense ); }
+inline void RtMidiIn :: setEventTypeFilter( unsigned int types ) { ((MidiInApi *)rtapi_)->setEventTypeFilter( types ); }
+inline void RtMidiIn :: setTimeSource( RtMidiTimeSource source, void *userData ) { ((MidiInApi *)rtapi_)->setTimeSource( source, userData ); }
+inline void RtMidiIn :: setRealtimeScheduling( bool enable, int priority, int cpu ) { ((MidiInApi *)rtapi_)->setRealtimeScheduling( enable, priority, cpu ); }
+inline RtMidiIn::ThreadPolicy RtMidiIn :: getThreadPolicy( int *priority ) { return ((MidiInApi *)rtapi_)->getThreadPolicy( priority ); }
 inline double RtMidiIn :: getMessage( std::vector<unsigned char> *message ) { return ((MidiInApi *)rtapi_)->getMessage( message ); }
+inline double RtMidiIn :: getMessage( std::vector<unsigned char> *message, uint64_t *timeNs ) { return ((MidiInApi *)rtapi_)->getMessage( message, timeNs ); }
 inline void RtMidiIn :: setErrorCallback( RtMidiErrorCallback errorCallback ) { rtapi_->setErrorCallback(errorCallback); }
 
 inline RtMidi::Api RtMidiOut :: getCurrentApi( void ) throw() { return rtapi_->getCurrentApi(); }
@@ -561,6 +879,9 @@ inline bool RtMidiOut :: isPortOpen() const { return rtapi_->isPortOpen(); }
 inline unsigned int RtMidiOut :: getPortCount( void ) { return rtapi_->getPortCount(); }
 inline std::string RtMidiOut :: getPortName( unsigned int portNumber ) { return rtapi_->getPortName( portNumber ); }
 inline void RtMidiOut :: sendMessage( std::vector<unsigned char> *message ) { ((MidiOutApi *)rtapi_)->sendMessage( message ); }
+inline void RtMidiOut :: sendMessage( const unsigned char *message, size_t size ) { ((MidiOutApi *)rtapi_)->sendBytes( message, size ); }
+inline void RtMidiOut :: scheduleMessage( std::vector<unsigned char> *message, double delay ) { ((MidiOutApi *)rtapi_)->scheduleMessage( message, delay ); }
+inline void RtMidiOut :: cancelScheduledMessages( void ) { ((MidiOutApi *)rtapi_)->cancelScheduledMessages(); }
 inline void RtMidiOut :: setErrorCallback( RtMidiErrorCallback errorCallback ) { rtapi_->setErrorCallback(errorCallback); }
 
 // **************************************************************** //
@@ -573,6 +894,12 @@ inline void RtMidiOut :: setErrorCallback( RtMidiErrorCallback errorCallback ) {
   #define __RTMIDI_DUMMY__
 #endif
 
+// The loopback API needs nothing but the C++ standard library, so it
+// is always available, unless disabled.
+#if !defined(__RTMIDI_NO_LOOPBACK__)
+  #define __RTMIDI_LOOPBACK__
+#endif
+
 #if defined(__MACOSX_CORE__)
 
 class MidiInCore: public MidiInApi
@@ -666,9 +993,11 @@ class MidiInAlsa: public MidiInApi
   void closePort( void );
   unsigned int getPortCount( void );
   std::string getPortName( unsigned int portNumber );
+  void setEventTypeFilter( unsigned int types );
 
  protected:
   void initialize( const std::string& clientName );
+  int startInputThread( void );
 };
 
 class MidiOutAlsa: public MidiOutApi
@@ -683,9 +1012,12 @@ class MidiOutAlsa: public MidiOutApi
   unsigned int getPortCount( void );
   std::string getPortName( unsigned int portNumber );
   void sendMessage( std::vector<unsigned char> *message );
+  void scheduleMessage( std::vector<unsigned char> *message, double delay );
+  void cancelScheduledMessages( void );
 
  protected:
   void initialize( const std::string& clientName );
+  void output( std::vector<unsigned char> *message, double delay );
 };
 
 #endif
@@ -762,4 +1094,42 @@ class MidiOutDummy: public MidiOutApi
 
 #endif
 
+#if defined(__RTMIDI_LOOPBACK__)
+
+class MidiInLoopback: public MidiInApi
+{
+ public:
+  MidiInLoopback( const std::string clientName, unsigned int queueSizeLimit );
+  ~MidiInLoopback( void );
+  RtMidi::Api getCurrentApi( void ) { return RtMidi::LOOPBACK; };
+  void openPort( unsigned int portNumber, const std::string portName );
+  void openVirtualPort( const std::string portName );
+  void closePort( void );
+  unsigned int getPortCount( void );
+  std::string getPortName( unsigned int portNumber );
+  void setTimeSource( RtMidiIn::RtMidiTimeSource source, void *userData );
+
+ protected:
+  void initialize( const std::string& clientName );
+};
+
+class MidiOutLoopback: public MidiOutApi
+{
+ public:
+  MidiOutLoopback( const std::string clientName );
+  ~MidiOutLoopback( void );
+  RtMidi::Api getCurrentApi( void ) { return RtMidi::LOOPBACK; };
+  void openPort( unsigned int portNumber, const std::string portName );
+  void openVirtualPort( const std::string portName );
+  void closePort( void );
+  unsigned int getPortCount( void );
+  std::string getPortName( unsigned int portNumber );
+  void sendMessage( std::vector<unsigned char> *message );
+
+ protected:
+  void initialize( const std::string& clientName );
+};
+
+#endif
+
 #endif
@@ -38,6 +38,62 @@
 
 #include "RtMidi.h"
 #include <sstream>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+
+// The current time on the std::chrono::steady_clock time base, in
+// nanoseconds, as used by RtMidiMessage::timeNs.
+inline uint64_t steadyTimeNs( void )
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+//*********************************************************************//
+//  RtMidiMessage Definitions
+//*********************************************************************//
+
+RtMidiMessage &RtMidiMessage :: operator=( const RtMidiMessage &other )
+{
+  if ( this != &other ) {
+    timeStamp = other.timeStamp;
+    timeNs = other.timeNs;
+    assign( other.data(), other.size() );
+  }
+  return *this;
+}
+
+void RtMidiMessage :: assign( const unsigned char *bytes, unsigned int nBytes )
+{
+  external_ = 0;
+  if ( nBytes <= INLINE_SIZE ) {
+    if ( nBytes ) std::memcpy( inline_, bytes, nBytes );
+    heap_.clear();
+  }
+  else
+    heap_.assign( bytes, bytes + nBytes );
+  size_ = nBytes;
+}
+
+void RtMidiMessage :: append( const unsigned char *bytes, unsigned int nBytes )
+{
+  // A view has to become an owning copy before it can grow.
+  if ( external_ ) {
+    const unsigned char *viewBytes = external_;
+    assign( viewBytes, size_ );
+  }
+
+  const unsigned int newSize = size_ + nBytes;
+  if ( newSize <= INLINE_SIZE ) {
+    if ( nBytes ) std::memcpy( inline_ + size_, bytes, nBytes );
+  }
+  else {
+    // Move inline bytes to heap storage first, if we outgrow them.
+    if ( size_ <= INLINE_SIZE ) heap_.assign( inline_, inline_ + size_ );
+    heap_.insert( heap_.end(), bytes, bytes + nBytes );
+  }
+  size_ = newSize;
+}
 
 //*********************************************************************//
 //  RtMidi Definitions
@@ -81,6 +137,9 @@ void RtMidi :: getCompiledApi( std::vector<RtMidi::Api> &apis ) throw()
 #if defined(__RTMIDI_DUMMY__)
   apis.push_back( RTMIDI_DUMMY );
 #endif
+#if defined(__RTMIDI_LOOPBACK__)
+  apis.push_back( LOOPBACK );
+#endif
 }
 
 //*********************************************************************//
@@ -113,6 +172,10 @@ void RtMidiIn :: openMidiApi( RtMidi::Api api, const std::string clientName, uns
   if ( api == RTMIDI_DUMMY )
     rtapi_ = new MidiInDummy( clientName, queueSizeLimit );
 #endif
+#if defined(__RTMIDI_LOOPBACK__)
+  if ( api == LOOPBACK )
+    rtapi_ = new MidiInLoopback( clientName, queueSizeLimit );
+#endif
 }
 
 RtMidiIn :: RtMidiIn( RtMidi::Api api, const std::string clientName, unsigned int queueSizeLimit )
@@ -133,6 +196,7 @@ RtMidiIn :: RtMidiIn( RtMidi::Api api, const std::string clientName, unsigned in
   std::vector< RtMidi::Api > apis;
   getCompiledApi( apis );
   for ( unsigned int i=0; i<apis.size(); i++ ) {
+    if ( apis[i] == LOOPBACK ) continue; // only when asked for explicitly
     openMidiApi( apis[i], clientName, queueSizeLimit );
     if ( rtapi_->getPortCount() ) break;
   }
@@ -182,6 +246,10 @@ void RtMidiOut :: openMidiApi( RtMidi::Api api, const std::string clientName )
   if ( api == RTMIDI_DUMMY )
     rtapi_ = new MidiOutDummy( clientName );
 #endif
+#if defined(__RTMIDI_LOOPBACK__)
+  if ( api == LOOPBACK )
+    rtapi_ = new MidiOutLoopback( clientName );
+#endif
 }
 
 RtMidiOut :: RtMidiOut( RtMidi::Api api, const std::string clientName )
@@ -201,6 +269,7 @@ RtMidiOut :: RtMidiOut( RtMidi::Api api, const std::string clientName )
   std::vector< RtMidi::Api > apis;
   getCompiledApi( apis );
   for ( unsigned int i=0; i<apis.size(); i++ ) {
+    if ( apis[i] == LOOPBACK ) continue; // only when asked for explicitly
     openMidiApi( apis[i], clientName );
     if ( rtapi_->getPortCount() ) break;
   }
@@ -272,39 +341,64 @@ void MidiApi :: error( RtMidiError::Type type, std::string errorString )
 //*********************************************************************//
 
 MidiInApi :: MidiInApi( unsigned int queueSizeLimit )
-  : MidiApi()
+  : MidiApi(), realtime_(false), realtimePriority_(0), realtimeCpu_(-1),
+    threadPolicy_(RtMidiIn::THREAD_UNSPECIFIED), threadPriority_(0)
 {
-  // Allocate the MIDI queue.
-  inputData_.queue.ringSize = queueSizeLimit;
-  if ( inputData_.queue.ringSize > 0 )
-    inputData_.queue.ring = new MidiMessage[ inputData_.queue.ringSize ];
+  // Allocate the MIDI queue, with one extra slot to tell full from empty.
+  inputData_.queue.ringSize = queueSizeLimit + 1;
+  inputData_.queue.ring = new MidiMessage[ inputData_.queue.ringSize ];
 }
 
 MidiInApi :: ~MidiInApi( void )
 {
   // Delete the MIDI queue.
-  if ( inputData_.queue.ringSize > 0 ) delete [] inputData_.queue.ring;
+  delete [] inputData_.queue.ring;
 }
 
-void MidiInApi :: setCallback( RtMidiIn::RtMidiCallback callback, void *userData )
+bool MidiInApi :: canSetCallback( bool callbackIsValid )
 {
   if ( inputData_.usingCallback ) {
     errorString_ = "MidiInApi::setCallback: a callback function is already set!";
     error( RtMidiError::WARNING, errorString_ );
-    return;
+    return false;
   }
 
-  if ( !callback ) {
+  if ( !callbackIsValid ) {
     errorString_ = "RtMidiIn::setCallback: callback function value is invalid!";
     error( RtMidiError::WARNING, errorString_ );
-    return;
+    return false;
   }
 
+  return true;
+}
+
+void MidiInApi :: setCallback( RtMidiIn::RtMidiCallback callback, void *userData )
+{
+  if ( !canSetCallback( callback != 0 ) ) return;
+
   inputData_.userCallback = callback;
   inputData_.userData = userData;
   inputData_.usingCallback = true;
 }
 
+void MidiInApi :: setRawCallback( RtMidiIn::RtMidiRawCallback callback, void *userData )
+{
+  if ( !canSetCallback( callback != 0 ) ) return;
+
+  inputData_.rawCallback = callback;
+  inputData_.userData = userData;
+  inputData_.usingCallback = true;
+}
+
+void MidiInApi :: setBatchCallback( RtMidiIn::RtMidiBatchCallback callback, void *userData )
+{
+  if ( !canSetCallback( callback != 0 ) ) return;
+
+  inputData_.batchCallback = callback;
+  inputData_.userData = userData;
+  inputData_.usingCallback = true;
+}
+
 void MidiInApi :: cancelCallback()
 {
   if ( !inputData_.usingCallback ) {
@@ -314,6 +408,8 @@ void MidiInApi :: cancelCallback()
   }
 
   inputData_.userCallback = 0;
+  inputData_.rawCallback = 0;
+  inputData_.batchCallback = 0;
   inputData_.userData = 0;
   inputData_.usingCallback = false;
 }
@@ -326,9 +422,33 @@ void MidiInApi :: ignoreTypes( bool midiSysex, bool midiTime, bool midiSense )
   if ( midiSense ) inputData_.ignoreFlags |= 0x04;
 }
 
-double MidiInApi :: getMessage( std::vector<unsigned char> *message )
+void MidiInApi :: setEventTypeFilter( unsigned int /*types*/ )
+{
+  // Only APIs which can filter events at the source implement this.
+}
+
+void MidiInApi :: setTimeSource( RtMidiIn::RtMidiTimeSource /*source*/, void * /*userData*/ )
+{
+  // Only APIs which stamp messages themselves implement this.
+}
+
+void MidiInApi :: setRealtimeScheduling( bool enable, int priority, int cpu )
+{
+  realtime_ = enable;
+  realtimePriority_ = priority;
+  realtimeCpu_ = cpu;
+}
+
+RtMidiIn::ThreadPolicy MidiInApi :: getThreadPolicy( int *priority )
+{
+  if ( priority ) *priority = threadPriority_;
+  return threadPolicy_;
+}
+
+double MidiInApi :: getMessage( std::vector<unsigned char> *message, uint64_t *timeNs )
 {
   message->clear();
+  if ( timeNs ) *timeNs = 0;
 
   if ( inputData_.usingCallback ) {
     errorString_ = "RtMidiIn::getNextMessage: a user callback is currently set for this port.";
@@ -336,20 +456,111 @@ double MidiInApi :: getMessage( std::vector<unsigned char> *message )
     return 0.0;
   }
 
-  if ( inputData_.queue.size == 0 ) return 0.0;
-
   // Copy queued message to the vector pointer argument and then "pop" it.
-  std::vector<unsigned char> *bytes = &(inputData_.queue.ring[inputData_.queue.front].bytes);
-  message->assign( bytes->begin(), bytes->end() );
-  double deltaTime = inputData_.queue.ring[inputData_.queue.front].timeStamp;
-  inputData_.queue.size--;
-  inputData_.queue.front++;
-  if ( inputData_.queue.front == inputData_.queue.ringSize )
-    inputData_.queue.front = 0;
+  double deltaTime = 0.0;
+  inputData_.queue.pop( message, &deltaTime, timeNs );
 
   return deltaTime;
 }
 
+//*********************************************************************//
+//  Common MidiInApi::MidiQueue Definitions
+//*********************************************************************//
+
+bool MidiInApi::MidiQueue :: push( const MidiInApi::MidiMessage &message )
+{
+  return push( &message, 1 ) == 1;
+}
+
+unsigned int MidiInApi::MidiQueue :: push( const MidiInApi::MidiMessage *messages, unsigned int count )
+{
+  // Only the producer writes "back", so a relaxed load is enough here.
+  unsigned int b = back.load( std::memory_order_relaxed );
+
+  // Acquire pairs with the consumer's release in pop(), so that the
+  // slots we are about to overwrite have been fully read.
+  const unsigned int f = front.load( std::memory_order_acquire );
+
+  unsigned int n = 0;
+  for ( ; n < count; ++n ) {
+    unsigned int next = b + 1;
+    if ( next == ringSize ) next = 0;
+    if ( next == f ) break;
+    ring[b] = messages[n];
+    b = next;
+  }
+
+  // Release publishes the slot contents before the new index.
+  if ( n ) back.store( b, std::memory_order_release );
+  return n;
+}
+
+bool MidiInApi::MidiQueue :: pop( std::vector<unsigned char> *message, double *timeStamp, uint64_t *timeNs )
+{
+  // Only the consumer writes "front", so a relaxed load is enough here.
+  const unsigned int f = front.load( std::memory_order_relaxed );
+
+  // Acquire pairs with the producer's release in push(), so that the
+  // slot contents are visible.
+  if ( f == back.load( std::memory_order_acquire ) ) return false;
+
+  message->assign( ring[f].data(), ring[f].data() + ring[f].size() );
+  *timeStamp = ring[f].timeStamp;
+  if ( timeNs ) *timeNs = ring[f].timeNs;
+
+  unsigned int next = f + 1;
+  if ( next == ringSize ) next = 0;
+
+  // Release hands the slot back to the producer.
+  front.store( next, std::memory_order_release );
+  return true;
+}
+
+unsigned int MidiInApi::MidiQueue :: size( void ) const
+{
+  const unsigned int f = front.load( std::memory_order_acquire );
+  const unsigned int b = back.load( std::memory_order_acquire );
+  return ( b >= f ) ? b - f : b + ringSize - f;
+}
+
+//*********************************************************************//
+//  Common MidiInApi::RtMidiInData Definitions
+//*********************************************************************//
+
+bool MidiInApi::RtMidiInData :: deliver( const MidiInApi::MidiMessage &message )
+{
+  if ( !usingCallback )
+    return queue.push( message );
+
+  if ( batchCallback ) {
+    batchCallback( &message, 1, userData );
+  }
+  else if ( rawCallback ) {
+    rawCallback( message.timeStamp, message.data(), message.size(), userData );
+  }
+  else {
+    // The std::vector is reused, so it only allocates while it grows.
+    callbackBytes.assign( message.data(), message.data() + message.size() );
+    userCallback( message.timeStamp, &callbackBytes, userData );
+  }
+  return true;
+}
+
+unsigned int MidiInApi::RtMidiInData :: deliver( const MidiInApi::MidiMessage *messages, unsigned int count )
+{
+  if ( !usingCallback )
+    return queue.push( messages, count );
+
+  if ( batchCallback ) {
+    batchCallback( messages, count, userData );
+    return count;
+  }
+
+  for ( unsigned int i=0; i<count; ++i )
+    deliver( messages[i] );
+  return count;
+}
+
 //*********************************************************************//
 //  Common MidiOutApi Definitions
 //*********************************************************************//
@@ -363,6 +574,25 @@ MidiOutApi :: ~MidiOutApi( void )
 {
 }
 
+void MidiOutApi :: scheduleMessage( std::vector<unsigned char> *message, double /*delay*/ )
+{
+  errorString_ = "MidiOutApi::scheduleMessage: scheduled output is not supported by this API, sending immediately.";
+  error( RtMidiError::DEBUG_WARNING, errorString_ );
+  sendMessage( message );
+}
+
+void MidiOutApi :: cancelScheduledMessages( void )
+{
+  // Nothing is ever scheduled.
+}
+
+void MidiOutApi :: sendBytes( const unsigned char *message, size_t size )
+{
+  // assign() keeps the buffer's capacity.
+  messageBuffer_.assign( message, message + size );
+  sendMessage( &messageBuffer_ );
+}
+
 // *************************************************** //
 //
 // OS/API-specific methods.
@@ -423,7 +653,11 @@ static void midiInputCallback( const MIDIPacketList *list, void *procRef, void *
     nBytes = packet->length;
     if ( nBytes == 0 ) continue;
 
-    // Calculate time stamp.
+    // Calculate time stamps.  CoreMIDI host time is the time base of
+    // std::chrono::steady_clock on OS-X, so it converts directly.
+    MIDITimeStamp hostTime = packet->timeStamp;
+    if ( hostTime == 0 ) hostTime = AudioGetCurrentHostTime();
+    uint64_t packetNs = AudioConvertHostTimeToNanos( hostTime );
 
     if ( data->firstMessage ) {
       message.timeStamp = 0.0;
@@ -450,29 +684,16 @@ static void midiInputCallback( const MIDIPacketList *list, void *procRef, void *
       // We have a continuing, segmented sysex message.
       if ( !( data->ignoreFlags & 0x01 ) ) {
         // If we're not ignoring sysex messages, copy the entire packet.
-        for ( unsigned int j=0; j<nBytes; ++j )
-          message.bytes.push_back( packet->data[j] );
+        message.append( packet->data, nBytes );
       }
       continueSysex = packet->data[nBytes-1] != 0xF7;
 
       if ( !( data->ignoreFlags & 0x01 ) && !continueSysex ) {
         // If not a continuing sysex message, invoke the user callback function or queue the message.
-        if ( data->usingCallback ) {
-          RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
-          callback( message.timeStamp, &message.bytes, data->userData );
-        }
-        else {
-          // As long as we haven't reached our queue size limit, push the message.
-          if ( data->queue.size < data->queue.ringSize ) {
-            data->queue.ring[data->queue.back++] = message;
-            if ( data->queue.back == data->queue.ringSize )
-              data->queue.back = 0;
-            data->queue.size++;
-          }
-          else
-            std::cerr << "\nMidiInCore: message queue limit reached!!\n\n";
-        }
-        message.bytes.clear();
+        // As long as we haven't reached our queue size limit, push the message.
+        if ( !data->deliver( message ) )
+          std::cerr << "\nMidiInCore: message queue limit reached!!\n\n";
+        message.clear();
       }
     }
     else {
@@ -518,25 +739,14 @@ static void midiInputCallback( const MIDIPacketList *list, void *procRef, void *
 
         // Copy the MIDI data to our vector.
         if ( size ) {
-          message.bytes.assign( &packet->data[iByte], &packet->data[iByte+size] );
+          message.assign( &packet->data[iByte], size );
+          message.timeNs = packetNs;
           if ( !continueSysex ) {
             // If not a continuing sysex message, invoke the user callback function or queue the message.
-            if ( data->usingCallback ) {
-              RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
-              callback( message.timeStamp, &message.bytes, data->userData );
-            }
-            else {
-              // As long as we haven't reached our queue size limit, push the message.
-              if ( data->queue.size < data->queue.ringSize ) {
-                data->queue.ring[data->queue.back++] = message;
-                if ( data->queue.back == data->queue.ringSize )
-                  data->queue.back = 0;
-                data->queue.size++;
-              }
-              else
-                std::cerr << "\nMidiInCore: message queue limit reached!!\n\n";
-            }
-            message.bytes.clear();
+            // As long as we haven't reached our queue size limit, push the message.
+            if ( !data->deliver( message ) )
+              std::cerr << "\nMidiInCore: message queue limit reached!!\n\n";
+            message.clear();
           }
           iByte += size;
         }
@@ -1100,6 +1310,7 @@ void MidiOutCore :: sendMessage( std::vector<unsigned char> *message )
 // associated with the ALSA sequencer queues.
 
 #include <pthread.h>
+#include <sched.h>
 #include <sys/time.h>
 
 // ALSA header file.
@@ -1120,10 +1331,21 @@ struct AlsaMidiData {
   unsigned long long lastTime;
   int queue_id; // an input queue is needed to get timestamped events
   int trigger_fds[2];
+  uint64_t queueStartNs; // steady clock time at which the input queue was started
 };
 
 #define PORT_TYPE( pinfo, bits ) ((snd_seq_port_info_get_capability(pinfo) & (bits)) == (bits))
 
+// Maximum number of input messages handed to the consumer in one call.
+#define RTMIDI_ALSA_BATCH_SIZE 64
+
+// Initial capacity of the sysex input arena, which grows as needed.
+#define RTMIDI_ALSA_SYSEX_RESERVE 1024
+
+// Number of events the kernel may hold for an output client, so that
+// scheduled messages can be queued well ahead of time.
+#define RTMIDI_ALSA_OUTPUT_POOL_SIZE 2000
+
 //*********************************************************************//
 //  API: LINUX ALSA
 //  Class Definitions: MidiInAlsa
@@ -1138,7 +1360,6 @@ static void *alsaMidiHandler( void *ptr )
   unsigned long long time, lastTime;
   bool continueSysex = false;
   bool doDecode = false;
-  MidiInApi::MidiMessage message;
   int poll_fd_count;
   struct pollfd *poll_fds;
 
@@ -1168,6 +1389,19 @@ static void *alsaMidiHandler( void *ptr )
   poll_fds[0].fd = apiData->trigger_fds[0];
   poll_fds[0].events = POLLIN;
 
+  // Events are read in batches: everything the sequencer has pending
+  // is drained per wakeup, and handed to the consumer in one call.
+  MidiInApi::MidiMessage batch[RTMIDI_ALSA_BATCH_SIZE];
+  unsigned int nBatch = 0;
+  unsigned char direct[3];
+  const unsigned char *bytes;
+
+  // Sysex messages are assembled in an arena which is kept and reused,
+  // and reach the consumer as a view of the arena, without a copy.
+  std::vector<unsigned char> sysex;
+  sysex.reserve( RTMIDI_ALSA_SYSEX_RESERVE );
+  bool flush;
+
   while ( data->doInput ) {
 
     if ( snd_seq_event_input_pending( apiData->seq, 1 ) == 0 ) {
@@ -1182,135 +1416,167 @@ static void *alsaMidiHandler( void *ptr )
       continue;
     }
 
-    // If here, there should be data.
-    result = snd_seq_event_input( apiData->seq, &ev );
-    if ( result == -ENOSPC ) {
-      std::cerr << "\nMidiInAlsa::alsaMidiHandler: MIDI input buffer overrun!\n\n";
-      continue;
-    }
-    else if ( result <= 0 ) {
-      std::cerr << "\nMidiInAlsa::alsaMidiHandler: unknown MIDI input error!\n";
-      perror("System reports");
-      continue;
-    }
-
-    // This is a bit weird, but we now have to decode an ALSA MIDI
-    // event (back) into MIDI bytes.  We'll ignore non-MIDI types.
-    if ( !continueSysex ) message.bytes.clear();
+    // If here, there should be data.  Drain all events which the
+    // sequencer has already handed to us before going back to poll().
+    do {
 
-    doDecode = false;
-    switch ( ev->type ) {
+      result = snd_seq_event_input( apiData->seq, &ev );
+      if ( result == -ENOSPC ) {
+        std::cerr << "\nMidiInAlsa::alsaMidiHandler: MIDI input buffer overrun!\n\n";
+        continue;
+      }
+      else if ( result <= 0 ) {
+        std::cerr << "\nMidiInAlsa::alsaMidiHandler: unknown MIDI input error!\n";
+        perror("System reports");
+        break;
+      }
 
-    case SND_SEQ_EVENT_PORT_SUBSCRIBED:
+      // This is a bit weird, but we now have to decode an ALSA MIDI
+      // event (back) into MIDI bytes.  We'll ignore non-MIDI types.
+      // Messages are written in place, to the next free batch slot.
+      MidiInApi::MidiMessage &message = batch[nBatch];
+
+      nBytes = 0;
+      bytes = buffer;
+      doDecode = false;
+      flush = false;
+      switch ( ev->type ) {
+
+      // Channel messages are by far the most frequent; we take their
+      // bytes straight from the event, without the generic decoder.
+      case SND_SEQ_EVENT_CONTROLLER:
+        direct[0] = 0xB0 | ( ev->data.control.channel & 0x0F );
+        direct[1] = ev->data.control.param & 0x7F;
+        direct[2] = ev->data.control.value & 0x7F;
+        bytes = direct;
+        nBytes = 3;
+        break;
+
+      case SND_SEQ_EVENT_NOTEON:
+      case SND_SEQ_EVENT_NOTEOFF:
+      case SND_SEQ_EVENT_KEYPRESS:
+        direct[0] = ( ev->type == SND_SEQ_EVENT_NOTEON ? 0x90 : ev->type == SND_SEQ_EVENT_NOTEOFF ? 0x80 : 0xA0 )
+                    | ( ev->data.note.channel & 0x0F );
+        direct[1] = ev->data.note.note & 0x7F;
+        direct[2] = ev->data.note.velocity & 0x7F;
+        bytes = direct;
+        nBytes = 3;
+        break;
+
+      case SND_SEQ_EVENT_PORT_SUBSCRIBED:
 #if defined(__RTMIDI_DEBUG__)
-      std::cout << "MidiInAlsa::alsaMidiHandler: port connection made!\n";
+        std::cout << "MidiInAlsa::alsaMidiHandler: port connection made!\n";
 #endif
-      break;
+        break;
 
-    case SND_SEQ_EVENT_PORT_UNSUBSCRIBED:
+      case SND_SEQ_EVENT_PORT_UNSUBSCRIBED:
 #if defined(__RTMIDI_DEBUG__)
-      std::cerr << "MidiInAlsa::alsaMidiHandler: port connection has closed!\n";
-      std::cout << "sender = " << (int) ev->data.connect.sender.client << ":"
-                << (int) ev->data.connect.sender.port
-                << ", dest = " << (int) ev->data.connect.dest.client << ":"
-                << (int) ev->data.connect.dest.port
-                << std::endl;
+        std::cerr << "MidiInAlsa::alsaMidiHandler: port connection has closed!\n";
+        std::cout << "sender = " << (int) ev->data.connect.sender.client << ":"
+                  << (int) ev->data.connect.sender.port
+                  << ", dest = " << (int) ev->data.connect.dest.client << ":"
+                  << (int) ev->data.connect.dest.port
+                  << std::endl;
 #endif
-      break;
-
-    case SND_SEQ_EVENT_QFRAME: // MIDI time code
-      if ( !( data->ignoreFlags & 0x02 ) ) doDecode = true;
-      break;
-
-    case SND_SEQ_EVENT_TICK: // 0xF9 ... MIDI timing tick
-      if ( !( data->ignoreFlags & 0x02 ) ) doDecode = true;
-      break;
-
-    case SND_SEQ_EVENT_CLOCK: // 0xF8 ... MIDI timing (clock) tick
-      if ( !( data->ignoreFlags & 0x02 ) ) doDecode = true;
-      break;
-
-    case SND_SEQ_EVENT_SENSING: // Active sensing
-      if ( !( data->ignoreFlags & 0x04 ) ) doDecode = true;
-      break;
-
-		case SND_SEQ_EVENT_SYSEX:
-      if ( (data->ignoreFlags & 0x01) ) break;
-      if ( ev->data.ext.len > apiData->bufferSize ) {
-        apiData->bufferSize = ev->data.ext.len;
-        free( buffer );
-        buffer = (unsigned char *) malloc( apiData->bufferSize );
-        if ( buffer == NULL ) {
-          data->doInput = false;
-          std::cerr << "\nMidiInAlsa::alsaMidiHandler: error resizing buffer memory!\n\n";
-          break;
-        }
-      }
+        break;
 
-    default:
-      doDecode = true;
-    }
+      case SND_SEQ_EVENT_QFRAME: // MIDI time code
+        if ( !( data->ignoreFlags & 0x02 ) ) doDecode = true;
+        break;
 
-    if ( doDecode ) {
+      case SND_SEQ_EVENT_TICK: // 0xF9 ... MIDI timing tick
+        if ( !( data->ignoreFlags & 0x02 ) ) doDecode = true;
+        break;
 
-      nBytes = snd_midi_event_decode( apiData->coder, buffer, apiData->bufferSize, ev );
-      if ( nBytes > 0 ) {
+      case SND_SEQ_EVENT_CLOCK: // 0xF8 ... MIDI timing (clock) tick
+        if ( !( data->ignoreFlags & 0x02 ) ) doDecode = true;
+        break;
+
+      case SND_SEQ_EVENT_SENSING: // Active sensing
+        if ( !( data->ignoreFlags & 0x04 ) ) doDecode = true;
+        break;
+
+      case SND_SEQ_EVENT_SYSEX:
+        if ( (data->ignoreFlags & 0x01) ) break;
         // The ALSA sequencer has a maximum buffer size for MIDI sysex
         // events of 256 bytes.  If a device sends sysex messages larger
         // than this, they are segmented into 256 byte chunks.  So,
         // we'll watch for this and concatenate sysex chunks into a
-        // single sysex message if necessary.
-        if ( !continueSysex )
-          message.bytes.assign( buffer, &buffer[nBytes] );
+        // single sysex message if necessary.  The event already holds
+        // the raw bytes, so there is nothing to decode.
+        if ( !continueSysex ) sysex.clear();
+        sysex.insert( sysex.end(), (const unsigned char *) ev->data.ext.ptr,
+                      (const unsigned char *) ev->data.ext.ptr + ev->data.ext.len );
+        continueSysex = sysex.empty() || sysex.back() != 0xF7;
+        if ( !continueSysex ) {
+          message.view( &sysex[0], sysex.size() );
+          bytes = 0;
+          nBytes = sysex.size();
+          // The arena is reused by the next sysex message, so the batch
+          // which refers to it goes out right away.
+          flush = true;
+        }
+        break;
+
+      default:
+        doDecode = true;
+      }
+
+      if ( doDecode )
+        nBytes = snd_midi_event_decode( apiData->coder, buffer, apiData->bufferSize, ev );
+
+      if ( nBytes > 0 ) {
+        if ( bytes ) message.assign( bytes, nBytes );
+
+        // Calculate the time stamp:
+        message.timeStamp = 0.0;
+
+        // Method 1: Use the system time.
+        //(void)gettimeofday(&tv, (struct timezone *)NULL);
+        //time = (tv.tv_sec * 1000000) + tv.tv_usec;
+
+        // Method 2: Use the ALSA sequencer event time data.
+        // (thanks to Pedro Lopez-Cabanillas!).
+        time = ( ev->time.time.tv_sec * 1000000 ) + ( ev->time.time.tv_nsec/1000 );
+        lastTime = time;
+        time -= apiData->lastTime;
+        apiData->lastTime = lastTime;
+        if ( data->firstMessage == true )
+          data->firstMessage = false;
         else
-          message.bytes.insert( message.bytes.end(), buffer, &buffer[nBytes] );
+          message.timeStamp = time * 0.000001;
 
-        continueSysex = ( ( ev->type == SND_SEQ_EVENT_SYSEX ) && ( message.bytes.back() != 0xF7 ) );
-        if ( !continueSysex ) {
+        // Event times are relative to the start of our input queue.
+#ifndef AVOID_TIMESTAMPING
+        message.timeNs = apiData->queueStartNs + ev->time.time.tv_sec * 1000000000ULL + ev->time.time.tv_nsec;
+#else
+        message.timeNs = steadyTimeNs();
+#endif
 
-          // Calculate the time stamp:
-          message.timeStamp = 0.0;
-
-          // Method 1: Use the system time.
-          //(void)gettimeofday(&tv, (struct timezone *)NULL);
-          //time = (tv.tv_sec * 1000000) + tv.tv_usec;
-
-          // Method 2: Use the ALSA sequencer event time data.
-          // (thanks to Pedro Lopez-Cabanillas!).
-          time = ( ev->time.time.tv_sec * 1000000 ) + ( ev->time.time.tv_nsec/1000 );
-          lastTime = time;
-          time -= apiData->lastTime;
-          apiData->lastTime = lastTime;
-          if ( data->firstMessage == true )
-            data->firstMessage = false;
-          else
-            message.timeStamp = time * 0.000001;
-        }
-        else {
+        // The message is complete, it now occupies its batch slot.
+        ++nBatch;
+      }
+      else if ( doDecode ) {
 #if defined(__RTMIDI_DEBUG__)
-          std::cerr << "\nMidiInAlsa::alsaMidiHandler: event parsing error or not a MIDI event!\n\n";
+        std::cerr << "\nMidiInAlsa::alsaMidiHandler: event parsing error or not a MIDI event!\n\n";
 #endif
-        }
       }
-    }
 
-    snd_seq_free_event( ev );
-    if ( message.bytes.size() == 0 || continueSysex ) continue;
+      snd_seq_free_event( ev );
 
-    if ( data->usingCallback ) {
-      RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
-      callback( message.timeStamp, &message.bytes, data->userData );
-    }
-    else {
-      // As long as we haven't reached our queue size limit, push the message.
-      if ( data->queue.size < data->queue.ringSize ) {
-        data->queue.ring[data->queue.back++] = message;
-        if ( data->queue.back == data->queue.ringSize )
-          data->queue.back = 0;
-        data->queue.size++;
+      if ( flush || nBatch == RTMIDI_ALSA_BATCH_SIZE ) {
+        if ( data->deliver( batch, nBatch ) < nBatch )
+          std::cerr << "\nMidiInAlsa: message queue limit reached!!\n\n";
+        nBatch = 0;
       }
-      else
+
+    } while ( data->doInput && snd_seq_event_input_pending( apiData->seq, 0 ) > 0 );
+
+    if ( nBatch > 0 ) {
+      // As long as we haven't reached our queue size limit, push the messages.
+      if ( data->deliver( batch, nBatch ) < nBatch )
         std::cerr << "\nMidiInAlsa: message queue limit reached!!\n\n";
+      nBatch = 0;
     }
   }
 
@@ -1549,16 +1815,11 @@ void MidiInAlsa :: openPort( unsigned int portNumber, const std::string portName
 #ifndef AVOID_TIMESTAMPING
     snd_seq_start_queue( data->seq, data->queue_id, NULL );
     snd_seq_drain_output( data->seq );
+    data->queueStartNs = steadyTimeNs();
 #endif
     // Start our MIDI input thread.
-    pthread_attr_t attr;
-    pthread_attr_init(&attr);
-    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
-    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
-
     inputData_.doInput = true;
-    int err = pthread_create(&data->thread, &attr, alsaMidiHandler, &inputData_);
-    pthread_attr_destroy(&attr);
+    int err = startInputThread();
     if ( err ) {
       snd_seq_unsubscribe_port( data->seq, data->subscription );
       snd_seq_port_subscribe_free( data->subscription );
@@ -1573,6 +1834,118 @@ void MidiInAlsa :: openPort( unsigned int portNumber, const std::string portName
   connected_ = true;
 }
 
+void MidiInAlsa :: setEventTypeFilter( unsigned int types )
+{
+  // ALSA sequencer event types for each RtMidiIn::EventType.
+  static const struct { unsigned int mask; int type; } eventTypes[] = {
+    { RtMidiIn::EVENT_NOTE, SND_SEQ_EVENT_NOTEON },
+    { RtMidiIn::EVENT_NOTE, SND_SEQ_EVENT_NOTEOFF },
+    { RtMidiIn::EVENT_NOTE, SND_SEQ_EVENT_KEYPRESS },
+    { RtMidiIn::EVENT_CONTROLLER, SND_SEQ_EVENT_CONTROLLER },
+    { RtMidiIn::EVENT_PROGRAM, SND_SEQ_EVENT_PGMCHANGE },
+    { RtMidiIn::EVENT_CHANNEL_PRESSURE, SND_SEQ_EVENT_CHANPRESS },
+    { RtMidiIn::EVENT_PITCHBEND, SND_SEQ_EVENT_PITCHBEND },
+    { RtMidiIn::EVENT_SYSEX, SND_SEQ_EVENT_SYSEX },
+    { RtMidiIn::EVENT_SYSTEM, SND_SEQ_EVENT_QFRAME },
+    { RtMidiIn::EVENT_SYSTEM, SND_SEQ_EVENT_SONGPOS },
+    { RtMidiIn::EVENT_SYSTEM, SND_SEQ_EVENT_SONGSEL },
+    { RtMidiIn::EVENT_SYSTEM, SND_SEQ_EVENT_TUNE_REQUEST },
+    { RtMidiIn::EVENT_SYSTEM, SND_SEQ_EVENT_CLOCK },
+    { RtMidiIn::EVENT_SYSTEM, SND_SEQ_EVENT_TICK },
+    { RtMidiIn::EVENT_SYSTEM, SND_SEQ_EVENT_START },
+    { RtMidiIn::EVENT_SYSTEM, SND_SEQ_EVENT_CONTINUE },
+    { RtMidiIn::EVENT_SYSTEM, SND_SEQ_EVENT_STOP },
+    { RtMidiIn::EVENT_SYSTEM, SND_SEQ_EVENT_SENSING },
+    { RtMidiIn::EVENT_SYSTEM, SND_SEQ_EVENT_RESET },
+  };
+
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  snd_seq_client_info_t *cinfo;
+  snd_seq_client_info_alloca( &cinfo );
+  if ( snd_seq_get_client_info( data->seq, cinfo ) < 0 ) {
+    errorString_ = "MidiInAlsa::setEventTypeFilter: error reading client info.";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  // Update the whole filter at once, rather than through
+  // snd_seq_set_client_event_filter(), which can only add types, and
+  // costs a round trip to the sequencer for each of them.
+  snd_seq_client_info_event_filter_clear( cinfo );
+  types &= RtMidiIn::EVENT_ALL;
+  if ( types != 0 && types != RtMidiIn::EVENT_ALL ) {
+    for ( unsigned int i=0; i<sizeof( eventTypes ) / sizeof( eventTypes[0] ); ++i )
+      if ( types & eventTypes[i].mask )
+        snd_seq_client_info_event_filter_add( cinfo, eventTypes[i].type );
+  }
+
+  if ( snd_seq_set_client_info( data->seq, cinfo ) < 0 ) {
+    errorString_ = "MidiInAlsa::setEventTypeFilter: error installing the event filter.";
+    error( RtMidiError::WARNING, errorString_ );
+  }
+}
+
+int MidiInAlsa :: startInputThread( void )
+{
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  pthread_attr_t attr;
+  int err = -1;
+
+  if ( realtime_ ) {
+    struct sched_param param;
+    param.sched_priority = std::max( sched_get_priority_min( SCHED_FIFO ),
+                                     std::min( sched_get_priority_max( SCHED_FIFO ), realtimePriority_ ) );
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+    pthread_attr_setschedparam(&attr, &param);
+    err = pthread_create(&data->thread, &attr, alsaMidiHandler, &inputData_);
+    pthread_attr_destroy(&attr);
+
+    if ( err ) {
+      // Usually EPERM: no CAP_SYS_NICE, or no rtprio limit for this user.
+      std::ostringstream ost;
+      ost << "MidiInAlsa::startInputThread: realtime scheduling not permitted (" << strerror( err ) << "), using the default policy.";
+      errorString_ = ost.str();
+      error( RtMidiError::WARNING, errorString_ );
+    }
+  }
+
+  if ( err ) {
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+    err = pthread_create(&data->thread, &attr, alsaMidiHandler, &inputData_);
+    pthread_attr_destroy(&attr);
+    if ( err ) return err;
+  }
+
+  if ( realtime_ && realtimeCpu_ >= 0 ) {
+    cpu_set_t cpus;
+    CPU_ZERO( &cpus );
+    CPU_SET( realtimeCpu_, &cpus );
+    if ( pthread_setaffinity_np( data->thread, sizeof( cpus ), &cpus ) ) {
+      errorString_ = "MidiInAlsa::startInputThread: could not set the input thread's CPU affinity.";
+      error( RtMidiError::WARNING, errorString_ );
+    }
+  }
+
+  // Report what we actually got.
+  int policy;
+  struct sched_param param;
+  if ( pthread_getschedparam( data->thread, &policy, &param ) == 0 ) {
+    threadPolicy_ = ( policy == SCHED_FIFO || policy == SCHED_RR ) ? RtMidiIn::THREAD_REALTIME : RtMidiIn::THREAD_NORMAL;
+    threadPriority_ = param.sched_priority;
+  }
+  else {
+    threadPolicy_ = RtMidiIn::THREAD_UNSPECIFIED;
+    threadPriority_ = 0;
+  }
+
+  return 0;
+}
+
 void MidiInAlsa :: openVirtualPort( std::string portName )
 {
   AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
@@ -1611,16 +1984,11 @@ void MidiInAlsa :: openVirtualPort( std::string portName )
 #ifndef AVOID_TIMESTAMPING
     snd_seq_start_queue( data->seq, data->queue_id, NULL );
     snd_seq_drain_output( data->seq );
+    data->queueStartNs = steadyTimeNs();
 #endif
     // Start our MIDI input thread.
-    pthread_attr_t attr;
-    pthread_attr_init(&attr);
-    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
-    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
-
     inputData_.doInput = true;
-    int err = pthread_create(&data->thread, &attr, alsaMidiHandler, &inputData_);
-    pthread_attr_destroy(&attr);
+    int err = startInputThread();
     if ( err ) {
       if ( data->subscription ) {
         snd_seq_unsubscribe_port( data->seq, data->subscription );
@@ -1683,6 +2051,7 @@ MidiOutAlsa :: ~MidiOutAlsa()
   if ( data->vport >= 0 ) snd_seq_delete_port( data->seq, data->vport );
   if ( data->coder ) snd_midi_event_free( data->coder );
   if ( data->buffer ) free( data->buffer );
+  if ( data->queue_id >= 0 ) snd_seq_free_queue( data->seq, data->queue_id );
   snd_seq_close( data->seq );
   delete data;
 }
@@ -1709,6 +2078,7 @@ void MidiOutAlsa :: initialize( const std::string& clientName )
   data->bufferSize = 32;
   data->coder = 0;
   data->buffer = 0;
+  data->queue_id = -1; // the output queue is allocated on first use
   int result = snd_midi_event_new( data->bufferSize, &data->coder );
   if ( result < 0 ) {
     delete data;
@@ -1855,6 +2225,51 @@ void MidiOutAlsa :: openVirtualPort( std::string portName )
 }
 
 void MidiOutAlsa :: sendMessage( std::vector<unsigned char> *message )
+{
+  output( message, -1.0 );
+}
+
+void MidiOutAlsa :: scheduleMessage( std::vector<unsigned char> *message, double delay )
+{
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+
+  if ( data->queue_id < 0 ) {
+    // Scheduled messages need a running queue, and room in the
+    // kernel's output pool for the messages which are waiting.
+    data->queue_id = snd_seq_alloc_named_queue( data->seq, "RtMidi Output Queue" );
+    if ( data->queue_id < 0 ) {
+      errorString_ = "MidiOutAlsa::scheduleMessage: error allocating output queue.";
+      error( RtMidiError::DRIVER_ERROR, errorString_ );
+      return;
+    }
+    snd_seq_set_client_pool_output( data->seq, RTMIDI_ALSA_OUTPUT_POOL_SIZE );
+    snd_seq_start_queue( data->seq, data->queue_id, NULL );
+    snd_seq_drain_output( data->seq );
+  }
+
+  output( message, delay < 0.0 ? 0.0 : delay );
+}
+
+void MidiOutAlsa :: cancelScheduledMessages( void )
+{
+  AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
+  if ( data->queue_id < 0 ) return;
+
+  // Events still in our output buffer - left there when the kernel's
+  // pool was full - have not reached the queue yet: drop them first,
+  // then remove what the queue holds.
+  snd_seq_drop_output( data->seq );
+
+  snd_seq_remove_events_t *remove;
+  snd_seq_remove_events_alloca( &remove );
+  snd_seq_remove_events_set_queue( remove, data->queue_id );
+  snd_seq_remove_events_set_condition( remove, SND_SEQ_REMOVE_OUTPUT | SND_SEQ_REMOVE_IGNORE_OFF );
+  snd_seq_remove_events( data->seq, remove );
+}
+
+// Send a message directly if delay is negative, otherwise schedule it
+// on the output queue, delay seconds from now.
+void MidiOutAlsa :: output( std::vector<unsigned char> *message, double delay )
 {
   int result;
   AlsaMidiData *data = static_cast<AlsaMidiData *> (apiData_);
@@ -1880,7 +2295,15 @@ void MidiOutAlsa :: sendMessage( std::vector<unsigned char> *message )
   snd_seq_ev_clear(&ev);
   snd_seq_ev_set_source(&ev, data->vport);
   snd_seq_ev_set_subs(&ev);
-  snd_seq_ev_set_direct(&ev);
+  if ( delay < 0.0 ) {
+    snd_seq_ev_set_direct(&ev);
+  }
+  else {
+    snd_seq_real_time_t time;
+    time.tv_sec = (unsigned int) delay;
+    time.tv_nsec = (unsigned int) ( ( delay - time.tv_sec ) * 1e9 );
+    snd_seq_ev_schedule_real(&ev, data->queue_id, 1, &time);
+  }
   for ( unsigned int i=0; i<nBytes; ++i ) data->buffer[i] = message->at(i);
   result = snd_midi_event_encode( data->coder, data->buffer, (long)nBytes, &ev );
   if ( result < (int)nBytes ) {
@@ -1960,6 +2383,10 @@ static void CALLBACK midiInputCallback( HMIDIIN /*hmin*/,
   else apiData->message.timeStamp = (double) ( timestamp - apiData->lastTime ) * 0.001;
   apiData->lastTime = timestamp;
 
+  // WinMM time stamps have millisecond resolution, and no known
+  // relation to any other clock; stamp the message on arrival instead.
+  apiData->message.timeNs = steadyTimeNs();
+
   if ( inputStatus == MIM_DATA ) { // Channel or system message
 
     // Make sure the first byte is a status byte.
@@ -1988,14 +2415,13 @@ static void CALLBACK midiInputCallback( HMIDIIN /*hmin*/,
 
     // Copy bytes to our MIDI message.
     unsigned char *ptr = (unsigned char *) &midiMessage;
-    for ( int i=0; i<nBytes; ++i ) apiData->message.bytes.push_back( *ptr++ );
+    apiData->message.append( ptr, nBytes );
   }
   else { // Sysex message ( MIM_LONGDATA or MIM_LONGERROR )
     MIDIHDR *sysex = ( MIDIHDR *) midiMessage; 
     if ( !( data->ignoreFlags & 0x01 ) && inputStatus != MIM_LONGERROR ) {  
       // Sysex message and we're not ignoring it
-      for ( int i=0; i<(int)sysex->dwBytesRecorded; ++i )
-        apiData->message.bytes.push_back( sysex->lpData[i] );
+      apiData->message.append( (const unsigned char *) sysex->lpData, sysex->dwBytesRecorded );
     }
 
     // The WinMM API requires that the sysex buffer be requeued after
@@ -2019,24 +2445,12 @@ static void CALLBACK midiInputCallback( HMIDIIN /*hmin*/,
     else return;
   }
 
-  if ( data->usingCallback ) {
-    RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) data->userCallback;
-    callback( apiData->message.timeStamp, &apiData->message.bytes, data->userData );
-  }
-  else {
-    // As long as we haven't reached our queue size limit, push the message.
-    if ( data->queue.size < data->queue.ringSize ) {
-      data->queue.ring[data->queue.back++] = apiData->message;
-      if ( data->queue.back == data->queue.ringSize )
-        data->queue.back = 0;
-      data->queue.size++;
-    }
-    else
-      std::cerr << "\nRtMidiIn: message queue limit reached!!\n\n";
-  }
+  // As long as we haven't reached our queue size limit, push the message.
+  if ( !data->deliver( apiData->message ) )
+    std::cerr << "\nRtMidiIn: message queue limit reached!!\n\n";
 
-  // Clear the vector for the next input message.
-  apiData->message.bytes.clear();
+  // Clear the message for the next input message.
+  apiData->message.clear();
 }
 
 MidiInWinMM :: MidiInWinMM( const std::string clientName, unsigned int queueSizeLimit ) : MidiInApi( queueSizeLimit )
@@ -2070,7 +2484,7 @@ void MidiInWinMM :: initialize( const std::string& /*clientName*/ )
   WinMidiData *data = (WinMidiData *) new WinMidiData;
   apiData_ = (void *) data;
   inputData_.apiData = (void *) data;
-  data->message.bytes.clear();  // needs to be empty for first input message
+  data->message.clear();  // needs to be empty for first input message
 
   if ( !InitializeCriticalSectionAndSpinCount(&(data->_mutex), 0x00000400) ) {
     errorString_ = "MidiInWinMM::initialize: InitializeCriticalSectionAndSpinCount failed.";
@@ -2438,8 +2852,18 @@ void MidiOutWinMM :: sendMessage( std::vector<unsigned char> *message )
 #include <jack/jack.h>
 #include <jack/midiport.h>
 #include <jack/ringbuffer.h>
+#include <pthread.h>
+#include <semaphore.h>
 
 #define JACK_RINGBUFFER_SIZE 16384 // Default size for ringbuffer
+#define JACK_INPUT_BATCH_SIZE 64   // Maximum number of input messages handed to the consumer in one call
+
+// Header of an incoming event in the input ringbuffer; the event's
+// bytes follow it.
+struct JackInputEvent {
+  jack_time_t time;
+  size_t size;
+};
 
 struct JackMidiData {
   jack_client_t *client;
@@ -2448,6 +2872,14 @@ struct JackMidiData {
   jack_ringbuffer_t *buffMessage;
   jack_time_t lastTime;
   MidiInApi :: RtMidiInData *rtMidiIn;
+
+  // Input only: the process callback writes raw events to buffIn and
+  // posts inputReady; the input thread decodes and delivers them.
+  jack_ringbuffer_t *buffIn;
+  sem_t inputReady;
+  pthread_t inputThread;
+  std::atomic<bool> inputRunning;
+  std::atomic<unsigned long> inputOverflows;
   };
 
 //*********************************************************************//
@@ -2455,12 +2887,14 @@ struct JackMidiData {
 //  Class Definitions: MidiInJack
 //*********************************************************************//
 
+// This runs in JACK's realtime process thread: it must neither
+// allocate, nor lock, nor do I/O.  It copies the raw events to the
+// input ringbuffer, and leaves everything else to jackInputHandler.
 static int jackProcessIn( jack_nframes_t nframes, void *arg )
 {
   JackMidiData *jData = (JackMidiData *) arg;
-  MidiInApi :: RtMidiInData *rtData = jData->rtMidiIn;
   jack_midi_event_t event;
-  jack_time_t time;
+  JackInputEvent header;
 
   // Is port created?
   if ( jData->port == NULL ) return 0;
@@ -2468,41 +2902,87 @@ static int jackProcessIn( jack_nframes_t nframes, void *arg )
 
   // We have midi events in buffer
   int evCount = jack_midi_get_event_count( buff );
-  for (int j = 0; j < evCount; j++) {
-    MidiInApi::MidiMessage message;
-    message.bytes.clear();
+  if ( evCount == 0 ) return 0;
 
+  jack_nframes_t cycleStart = jack_last_frame_time( jData->client );
+  int written = 0;
+  for (int j = 0; j < evCount; j++) {
     jack_midi_event_get( &event, buff, j );
 
-    for ( unsigned int i = 0; i < event.size; i++ )
-      message.bytes.push_back( event.buffer[i] );
+    if ( jack_ringbuffer_write_space( jData->buffIn ) < sizeof( header ) + event.size ) {
+      // Counted here, reported by the input thread.
+      jData->inputOverflows.fetch_add( 1, std::memory_order_relaxed );
+      continue;
+    }
 
-    // Compute the delta time.
-    time = jack_get_time();
-    if ( rtData->firstMessage == true )
-      rtData->firstMessage = false;
-    else
-      message.timeStamp = ( time - jData->lastTime ) * 0.000001;
+    // Frame-accurate time of the event, in microseconds.
+    header.time = jack_frames_to_time( jData->client, cycleStart + event.time );
+    header.size = event.size;
+    jack_ringbuffer_write( jData->buffIn, (const char *) &header, sizeof( header ) );
+    jack_ringbuffer_write( jData->buffIn, (const char *) event.buffer, event.size );
+    ++written;
+  }
 
-    jData->lastTime = time;
+  if ( written ) sem_post( &jData->inputReady );
 
-    if ( !rtData->continueSysex ) {
-      if ( rtData->usingCallback ) {
-        RtMidiIn::RtMidiCallback callback = (RtMidiIn::RtMidiCallback) rtData->userCallback;
-        callback( message.timeStamp, &message.bytes, rtData->userData );
-      }
-      else {
-        // As long as we haven't reached our queue size limit, push the message.
-        if ( rtData->queue.size < rtData->queue.ringSize ) {
-          rtData->queue.ring[rtData->queue.back++] = message;
-          if ( rtData->queue.back == rtData->queue.ringSize )
-            rtData->queue.back = 0;
-          rtData->queue.size++;
-        }
-        else
+  return 0;
+}
+
+static void *jackInputHandler( void *ptr )
+{
+  JackMidiData *jData = (JackMidiData *) ptr;
+  MidiInApi :: RtMidiInData *rtData = jData->rtMidiIn;
+  MidiInApi::MidiMessage batch[JACK_INPUT_BATCH_SIZE];
+  unsigned int nBatch = 0;
+  std::vector<unsigned char> bytes( 256 );
+  JackInputEvent header;
+
+  // Offset from JACK's microsecond clock to the steady clock.
+  const int64_t jackToSteadyNs = (int64_t) steadyTimeNs() - (int64_t) jack_get_time() * 1000;
+
+  while ( true ) {
+    sem_wait( &jData->inputReady );
+    if ( !jData->inputRunning.load( std::memory_order_acquire ) ) break;
+
+    unsigned long overflows = jData->inputOverflows.exchange( 0, std::memory_order_relaxed );
+    if ( overflows )
+      std::cerr << "\nMidiInJack: input ringbuffer full, " << overflows << " event(s) dropped!!\n\n";
+
+    // The process callback writes the header and the bytes of an event
+    // separately, so we only consume events which are complete.
+    while ( jack_ringbuffer_read_space( jData->buffIn ) >= sizeof( header ) ) {
+      jack_ringbuffer_peek( jData->buffIn, (char *) &header, sizeof( header ) );
+      if ( jack_ringbuffer_read_space( jData->buffIn ) < sizeof( header ) + header.size ) break;
+
+      jack_ringbuffer_read_advance( jData->buffIn, sizeof( header ) );
+      if ( header.size > bytes.size() ) bytes.resize( header.size );
+      jack_ringbuffer_read( jData->buffIn, (char *) bytes.data(), header.size );
+
+      MidiInApi::MidiMessage &message = batch[nBatch];
+      message.assign( bytes.data(), header.size );
+
+      // Compute the delta time.
+      message.timeStamp = 0.0;
+      if ( rtData->firstMessage == true )
+        rtData->firstMessage = false;
+      else
+        message.timeStamp = ( header.time - jData->lastTime ) * 0.000001;
+      jData->lastTime = header.time;
+      message.timeNs = (uint64_t) ( (int64_t) header.time * 1000 + jackToSteadyNs );
+
+      if ( ++nBatch == JACK_INPUT_BATCH_SIZE ) {
+        if ( rtData->deliver( batch, nBatch ) < nBatch )
           std::cerr << "\nMidiInJack: message queue limit reached!!\n\n";
+        nBatch = 0;
       }
     }
+
+    if ( nBatch > 0 ) {
+      // As long as we haven't reached our queue size limit, push the messages.
+      if ( rtData->deliver( batch, nBatch ) < nBatch )
+        std::cerr << "\nMidiInJack: message queue limit reached!!\n\n";
+      nBatch = 0;
+    }
   }
 
   return 0;
@@ -2521,8 +3001,23 @@ void MidiInJack :: initialize( const std::string& clientName )
   data->rtMidiIn = &inputData_;
   data->port = NULL;
   data->client = NULL;
+  data->lastTime = 0;
   this->clientName = clientName;
 
+  // Everything the process callback needs is allocated up front, and
+  // locked into memory.
+  data->buffIn = jack_ringbuffer_create( JACK_RINGBUFFER_SIZE );
+  jack_ringbuffer_mlock( data->buffIn );
+  data->inputOverflows = 0;
+  data->inputRunning = true;
+  sem_init( &data->inputReady, 0, 0 );
+  if ( pthread_create( &data->inputThread, NULL, jackInputHandler, data ) ) {
+    data->inputRunning = false;
+    errorString_ = "MidiInJack::initialize: error starting MIDI input thread!";
+    error( RtMidiError::THREAD_ERROR, errorString_ );
+    return;
+  }
+
   connect();
 }
 
@@ -2550,6 +3045,15 @@ MidiInJack :: ~MidiInJack()
 
   if ( data->client )
     jack_client_close( data->client );
+
+  // The process callback is gone now; stop the input thread.
+  if ( data->inputRunning ) {
+    data->inputRunning.store( false, std::memory_order_release );
+    sem_post( &data->inputReady );
+    pthread_join( data->inputThread, NULL );
+  }
+  sem_destroy( &data->inputReady );
+  jack_ringbuffer_free( data->buffIn );
   delete data;
 }
 
@@ -2837,3 +3341,484 @@ void MidiOutJack :: sendMessage( std::vector<unsigned char> *message )
 }
 
 #endif  // __UNIX_JACK__
+
+
+//*********************************************************************//
+//  API: Loopback
+//
+//  In-process ports, which stand in for devices, so that input and
+//  output paths can be run without hardware or a MIDI system.
+//*********************************************************************//
+
+#if defined(__RTMIDI_LOOPBACK__)
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#define LOOPBACK_RING_SIZE 1024 // Messages per input which may wait for delivery
+
+// An input's ring, and the thread which delivers from it.  Producers
+// hold the bus mutex, so there is only ever one at a time.
+struct LoopbackInput {
+  MidiInApi::RtMidiInData *data;
+  MidiInApi::MidiMessage ring[LOOPBACK_RING_SIZE];
+  std::atomic<unsigned int> front;
+  std::atomic<unsigned int> back;
+  std::mutex mutex;
+  std::condition_variable ready;
+  bool running;
+  std::thread thread;
+  uint64_t lastTimeNs;
+  RtMidiIn::RtMidiTimeSource timeSource; // Guarded by the bus mutex.
+  void *timeSourceData;
+
+  LoopbackInput( MidiInApi::RtMidiInData *inputData )
+    : data( inputData ), front( 0 ), back( 0 ), running( true ), lastTimeNs( 0 ),
+      timeSource( 0 ), timeSourceData( 0 ) {}
+
+  bool push( const unsigned char *message, size_t size, uint64_t timeNs );
+  void run( void );
+  void stop( void );
+};
+
+struct LoopbackPort {
+  std::string name;
+  bool echo;
+  bool capture;
+  std::vector<LoopbackInput *> inputs;
+  std::vector< std::vector<unsigned char> > captured;
+  unsigned long long sent;
+  unsigned long long sentBytes;
+};
+
+struct LoopbackBus {
+  std::mutex mutex;
+  std::vector< std::shared_ptr<LoopbackPort> > ports;
+  RtMidiLoopback::TimeSource timeSource;
+  void *timeSourceData;
+
+  LoopbackBus() : timeSource( 0 ), timeSourceData( 0 ) {}
+
+  // The caller must hold the mutex.
+  uint64_t now( const LoopbackInput *input ) {
+    if ( input->timeSource ) return input->timeSource( input->timeSourceData );
+    return timeSource ? timeSource( timeSourceData ) : steadyTimeNs();
+  }
+
+  // The caller must hold the mutex.
+  std::shared_ptr<LoopbackPort> find( const std::string &name ) {
+    for ( unsigned int i=0; i<ports.size(); ++i )
+      if ( ports[i]->name == name ) return ports[i];
+    return std::shared_ptr<LoopbackPort>();
+  }
+};
+
+static LoopbackBus &loopbackBus( void )
+{
+  static LoopbackBus bus;
+  return bus;
+}
+
+struct LoopbackMidiData {
+  std::shared_ptr<LoopbackPort> port;
+  LoopbackInput *input; // inputs only
+  RtMidiIn::RtMidiTimeSource timeSource; // inputs only, handed on to input
+  void *timeSourceData;
+};
+
+bool LoopbackInput :: push( const unsigned char *message, size_t size, uint64_t timeNs )
+{
+  if ( size == 0 ) return true;
+
+  // Apply the same filtering as the system APIs.
+  const unsigned char status = message[0];
+  if ( ( status == 0xF0 && ( data->ignoreFlags & 0x01 ) ) ||
+       ( ( status == 0xF1 || status == 0xF8 ) && ( data->ignoreFlags & 0x02 ) ) ||
+       ( status == 0xFE && ( data->ignoreFlags & 0x04 ) ) )
+    return true;
+
+  const unsigned int b = back.load( std::memory_order_relaxed );
+  const unsigned int next = ( b + 1 ) % LOOPBACK_RING_SIZE;
+  if ( next == front.load( std::memory_order_acquire ) ) return false;
+
+  ring[b].assign( message, size );
+  ring[b].timeNs = timeNs;
+  back.store( next, std::memory_order_release );
+
+  // Taking the mutex, however briefly, makes sure that the delivery
+  // thread is either before its check of the ring, or waiting.
+  { std::lock_guard<std::mutex> lock( mutex ); }
+  ready.notify_one();
+  return true;
+}
+
+void LoopbackInput :: run( void )
+{
+  while ( true ) {
+    {
+      std::unique_lock<std::mutex> lock( mutex );
+      ready.wait( lock, [this] {
+          return !running || front.load( std::memory_order_relaxed ) != back.load( std::memory_order_acquire ); } );
+      if ( !running ) break;
+    }
+
+    // Deliver straight from the ring, in (at most two) contiguous runs.
+    unsigned int f = front.load( std::memory_order_relaxed );
+    const unsigned int b = back.load( std::memory_order_acquire );
+    while ( f != b ) {
+      const unsigned int end = b > f ? b : LOOPBACK_RING_SIZE;
+      for ( unsigned int i=f; i<end; ++i ) {
+        if ( data->firstMessage == true ) {
+          ring[i].timeStamp = 0.0;
+          data->firstMessage = false;
+        }
+        else ring[i].timeStamp = ( ring[i].timeNs - lastTimeNs ) * 0.000000001;
+        lastTimeNs = ring[i].timeNs;
+      }
+
+      const unsigned int count = end - f;
+      if ( data->deliver( &ring[f], count ) < count )
+        std::cerr << "\nMidiInLoopback: message queue limit reached!!\n\n";
+
+      f = end % LOOPBACK_RING_SIZE;
+      front.store( f, std::memory_order_release );
+    }
+  }
+}
+
+void LoopbackInput :: stop( void )
+{
+  {
+    std::lock_guard<std::mutex> lock( mutex );
+    running = false;
+  }
+  ready.notify_one();
+  if ( thread.joinable() ) thread.join();
+}
+
+//*********************************************************************//
+//  API: Loopback
+//  Class Definitions: RtMidiLoopback
+//*********************************************************************//
+
+void RtMidiLoopback :: createPort( const std::string &name, bool echo, bool capture )
+{
+  LoopbackBus &bus = loopbackBus();
+  std::lock_guard<std::mutex> lock( bus.mutex );
+
+  std::shared_ptr<LoopbackPort> port = bus.find( name );
+  if ( !port ) {
+    port = std::make_shared<LoopbackPort>();
+    port->name = name;
+    port->sent = 0;
+    port->sentBytes = 0;
+    bus.ports.push_back( port );
+  }
+  port->echo = echo;
+  port->capture = capture;
+}
+
+void RtMidiLoopback :: removePort( const std::string &name )
+{
+  LoopbackBus &bus = loopbackBus();
+  std::lock_guard<std::mutex> lock( bus.mutex );
+
+  for ( unsigned int i=0; i<bus.ports.size(); ++i ) {
+    if ( bus.ports[i]->name == name ) {
+      bus.ports[i]->inputs.clear();
+      bus.ports.erase( bus.ports.begin() + i );
+      return;
+    }
+  }
+}
+
+bool RtMidiLoopback :: inject( const std::string &name, const unsigned char *message, size_t size )
+{
+  LoopbackBus &bus = loopbackBus();
+  std::lock_guard<std::mutex> lock( bus.mutex );
+
+  std::shared_ptr<LoopbackPort> port = bus.find( name );
+  if ( !port ) return false;
+
+  bool delivered = true;
+  for ( unsigned int i=0; i<port->inputs.size(); ++i )
+    delivered = port->inputs[i]->push( message, size, bus.now( port->inputs[i] ) ) && delivered;
+  return delivered;
+}
+
+std::vector< std::vector<unsigned char> > RtMidiLoopback :: capture( const std::string &name )
+{
+  LoopbackBus &bus = loopbackBus();
+  std::lock_guard<std::mutex> lock( bus.mutex );
+
+  std::vector< std::vector<unsigned char> > captured;
+  std::shared_ptr<LoopbackPort> port = bus.find( name );
+  if ( port ) captured.swap( port->captured );
+  return captured;
+}
+
+unsigned long long RtMidiLoopback :: sentCount( const std::string &name )
+{
+  LoopbackBus &bus = loopbackBus();
+  std::lock_guard<std::mutex> lock( bus.mutex );
+
+  std::shared_ptr<LoopbackPort> port = bus.find( name );
+  return port ? port->sent : 0;
+}
+
+unsigned long long RtMidiLoopback :: sentBytes( const std::string &name )
+{
+  LoopbackBus &bus = loopbackBus();
+  std::lock_guard<std::mutex> lock( bus.mutex );
+
+  std::shared_ptr<LoopbackPort> port = bus.find( name );
+  return port ? port->sentBytes : 0;
+}
+
+void RtMidiLoopback :: setTimeSource( TimeSource source, void *userData )
+{
+  LoopbackBus &bus = loopbackBus();
+  std::lock_guard<std::mutex> lock( bus.mutex );
+
+  bus.timeSource = source;
+  bus.timeSourceData = source ? userData : 0;
+}
+
+// Port number of a named port, or -1.
+static int loopbackPortNumber( const std::string &name )
+{
+  LoopbackBus &bus = loopbackBus();
+  std::lock_guard<std::mutex> lock( bus.mutex );
+
+  for ( unsigned int i=0; i<bus.ports.size(); ++i )
+    if ( bus.ports[i]->name == name ) return i;
+  return -1;
+}
+
+static unsigned int loopbackPortCount( void )
+{
+  LoopbackBus &bus = loopbackBus();
+  std::lock_guard<std::mutex> lock( bus.mutex );
+  return bus.ports.size();
+}
+
+static std::string loopbackPortName( unsigned int portNumber )
+{
+  LoopbackBus &bus = loopbackBus();
+  std::lock_guard<std::mutex> lock( bus.mutex );
+  return portNumber < bus.ports.size() ? bus.ports[portNumber]->name : std::string();
+}
+
+//*********************************************************************//
+//  API: Loopback
+//  Class Definitions: MidiInLoopback
+//*********************************************************************//
+
+MidiInLoopback :: MidiInLoopback( const std::string clientName, unsigned int queueSizeLimit ) : MidiInApi( queueSizeLimit )
+{
+  initialize( clientName );
+}
+
+MidiInLoopback :: ~MidiInLoopback()
+{
+  closePort();
+  delete static_cast<LoopbackMidiData *> (apiData_);
+}
+
+void MidiInLoopback :: initialize( const std::string& /*clientName*/ )
+{
+  LoopbackMidiData *data = new LoopbackMidiData;
+  data->input = 0;
+  data->timeSource = 0;
+  data->timeSourceData = 0;
+  apiData_ = (void *) data;
+  inputData_.apiData = (void *) data;
+}
+
+void MidiInLoopback :: openPort( unsigned int portNumber, const std::string /*portName*/ )
+{
+  if ( connected_ ) {
+    errorString_ = "MidiInLoopback::openPort: a valid connection already exists!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  LoopbackMidiData *data = static_cast<LoopbackMidiData *> (apiData_);
+  {
+    LoopbackBus &bus = loopbackBus();
+    std::lock_guard<std::mutex> lock( bus.mutex );
+    if ( portNumber < bus.ports.size() ) {
+      data->port = bus.ports[portNumber];
+      data->input = new LoopbackInput( &inputData_ );
+      data->input->timeSource = data->timeSource;
+      data->input->timeSourceData = data->timeSourceData;
+      data->input->thread = std::thread( &LoopbackInput::run, data->input );
+      data->port->inputs.push_back( data->input );
+    }
+  }
+
+  if ( !data->port ) {
+    std::ostringstream ost;
+    ost << "MidiInLoopback::openPort: the 'portNumber' argument (" << portNumber << ") is invalid.";
+    errorString_ = ost.str();
+    error( RtMidiError::INVALID_PARAMETER, errorString_ );
+    return;
+  }
+
+  connected_ = true;
+}
+
+void MidiInLoopback :: openVirtualPort( const std::string portName )
+{
+  RtMidiLoopback::createPort( portName );
+  openPort( loopbackPortNumber( portName ), portName );
+}
+
+void MidiInLoopback :: closePort( void )
+{
+  LoopbackMidiData *data = static_cast<LoopbackMidiData *> (apiData_);
+  if ( !data->port ) return;
+
+  {
+    LoopbackBus &bus = loopbackBus();
+    std::lock_guard<std::mutex> lock( bus.mutex );
+    std::vector<LoopbackInput *> &inputs = data->port->inputs;
+    for ( unsigned int i=0; i<inputs.size(); ++i ) {
+      if ( inputs[i] == data->input ) {
+        inputs.erase( inputs.begin() + i );
+        break;
+      }
+    }
+  }
+
+  data->input->stop();
+  delete data->input;
+  data->input = 0;
+  data->port.reset();
+  connected_ = false;
+}
+
+unsigned int MidiInLoopback :: getPortCount()
+{
+  return loopbackPortCount();
+}
+
+std::string MidiInLoopback :: getPortName( unsigned int portNumber )
+{
+  return loopbackPortName( portNumber );
+}
+
+void MidiInLoopback :: setTimeSource( RtMidiIn::RtMidiTimeSource source, void *userData )
+{
+  LoopbackMidiData *data = static_cast<LoopbackMidiData *> (apiData_);
+
+  LoopbackBus &bus = loopbackBus();
+  std::lock_guard<std::mutex> lock( bus.mutex );
+  data->timeSource = source;
+  data->timeSourceData = source ? userData : 0;
+  if ( data->input ) {
+    data->input->timeSource = data->timeSource;
+    data->input->timeSourceData = data->timeSourceData;
+  }
+}
+
+//*********************************************************************//
+//  API: Loopback
+//  Class Definitions: MidiOutLoopback
+//*********************************************************************//
+
+MidiOutLoopback :: MidiOutLoopback( const std::string clientName ) : MidiOutApi()
+{
+  initialize( clientName );
+}
+
+MidiOutLoopback :: ~MidiOutLoopback()
+{
+  closePort();
+  delete static_cast<LoopbackMidiData *> (apiData_);
+}
+
+void MidiOutLoopback :: initialize( const std::string& /*clientName*/ )
+{
+  LoopbackMidiData *data = new LoopbackMidiData;
+  data->input = 0;
+  data->timeSource = 0;
+  data->timeSourceData = 0;
+  apiData_ = (void *) data;
+}
+
+void MidiOutLoopback :: openPort( unsigned int portNumber, const std::string /*portName*/ )
+{
+  if ( connected_ ) {
+    errorString_ = "MidiOutLoopback::openPort: a valid connection already exists!";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  LoopbackMidiData *data = static_cast<LoopbackMidiData *> (apiData_);
+  {
+    LoopbackBus &bus = loopbackBus();
+    std::lock_guard<std::mutex> lock( bus.mutex );
+    if ( portNumber < bus.ports.size() ) data->port = bus.ports[portNumber];
+  }
+
+  if ( !data->port ) {
+    std::ostringstream ost;
+    ost << "MidiOutLoopback::openPort: the 'portNumber' argument (" << portNumber << ") is invalid.";
+    errorString_ = ost.str();
+    error( RtMidiError::INVALID_PARAMETER, errorString_ );
+    return;
+  }
+
+  connected_ = true;
+}
+
+void MidiOutLoopback :: openVirtualPort( const std::string portName )
+{
+  RtMidiLoopback::createPort( portName );
+  openPort( loopbackPortNumber( portName ), portName );
+}
+
+void MidiOutLoopback :: closePort( void )
+{
+  LoopbackMidiData *data = static_cast<LoopbackMidiData *> (apiData_);
+  data->port.reset();
+  connected_ = false;
+}
+
+unsigned int MidiOutLoopback :: getPortCount()
+{
+  return loopbackPortCount();
+}
+
+std::string MidiOutLoopback :: getPortName( unsigned int portNumber )
+{
+  return loopbackPortName( portNumber );
+}
+
+void MidiOutLoopback :: sendMessage( std::vector<unsigned char> *message )
+{
+  LoopbackMidiData *data = static_cast<LoopbackMidiData *> (apiData_);
+  if ( !data->port ) {
+    errorString_ = "MidiOutLoopback::sendMessage: no open port.";
+    error( RtMidiError::WARNING, errorString_ );
+    return;
+  }
+
+  LoopbackBus &bus = loopbackBus();
+  std::lock_guard<std::mutex> lock( bus.mutex );
+
+  LoopbackPort &port = *data->port;
+  ++port.sent;
+  port.sentBytes += message->size();
+  if ( port.capture ) port.captured.push_back( *message );
+  if ( port.echo && !message->empty() ) {
+    for ( unsigned int i=0; i<port.inputs.size(); ++i )
+      if ( !port.inputs[i]->push( &( *message )[0], message->size(), bus.now( port.inputs[i] ) ) )
+        std::cerr << "\nMidiOutLoopback: input ring full, message dropped!!\n\n";
+  }
+}
+
+#endif  // __RTMIDI_LOOPBACK__
@@ -0,0 +1,53 @@
+#include "Clock.h"
+
+#include <chrono>
+#include <thread>
+
+using namespace pal::Kontrol;
+
+// ------------------------------------------------------
+
+uint64_t SteadyClock::nowNs() const {
+	return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// ------------------------------------------------------
+
+void SteadyClock::sleepNs(uint64_t ns_) {
+	std::this_thread::sleep_for(std::chrono::nanoseconds(ns_));
+}
+
+// ------------------------------------------------------
+
+SteadyClock& SteadyClock::instance() {
+	static SteadyClock clock;
+	return clock;
+}
+
+// ------------------------------------------------------
+
+VirtualClock::VirtualClock(uint64_t startNs_)
+	: mNowNs(startNs_) {
+}
+
+// ------------------------------------------------------
+
+uint64_t VirtualClock::nowNs() const {
+	return mNowNs.load(std::memory_order_acquire);
+}
+
+// ------------------------------------------------------
+
+void VirtualClock::sleepNs(uint64_t ns_) {
+	advanceNs(ns_);
+
+	// whatever we are waiting for may happen on another thread.
+	std::this_thread::yield();
+}
+
+// ------------------------------------------------------
+
+void VirtualClock::advanceNs(uint64_t ns_) {
+	mNowNs.fetch_add(ns_, std::memory_order_acq_rel);
+}
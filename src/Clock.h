@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+namespace pal {
+namespace Kontrol {
+
+/*
+
+Where TwisterCore gets the time from: latency stamps, session
+recording and replay, preset morphs, the latency dump interval, and
+the pacing and timeout of config uploads.
+
+SteadyClock is std::chrono::steady_clock - the same clock that RtMidi
+stamps device input with - and the default.
+
+VirtualClock only moves when told to, so that timing becomes
+reproducible: replayed sessions are due, morphs progress and latencies
+measure exactly as the test advances the clock. Sleeping on a virtual
+clock advances it, and takes no real time. RtMidi's loopback api
+stamps input with the core's clock, too (see TwisterCore::setClock),
+but a device does not: live input and a virtual clock don't mix.
+
+Tracing (see TraceRecorder) stays on the steady clock, as it profiles
+what the code really costs - only midi arrivals in a trace carry their
+message's stamp, on this clock.
+
+*/
+
+class Clock
+{
+public:
+	virtual ~Clock() {}
+
+	virtual uint64_t nowNs() const = 0;
+	virtual void     sleepNs(uint64_t ns_) = 0;
+
+	uint64_t nowMs() const { return nowNs() / 1000000; }
+	void     sleepMs(uint64_t ms_) { sleepNs(ms_ * 1000000); }
+};
+
+// ------------------------------------------------------
+
+class SteadyClock : public Clock
+{
+public:
+	uint64_t nowNs() const override;
+	void     sleepNs(uint64_t ns_) override;
+
+	// stateless, so one instance serves everyone.
+	static SteadyClock& instance();
+};
+
+// ------------------------------------------------------
+
+// may be read from any thread; advance it from one thread at a time.
+class VirtualClock : public Clock
+{
+public:
+	// 0 would read as "unknown" in message stamps,
+	// so the clock starts at one second.
+	explicit VirtualClock(uint64_t startNs_ = 1000000000ULL);
+
+	uint64_t nowNs() const override;
+	void     sleepNs(uint64_t ns_) override; ///< advances the clock, and yields
+
+	void advanceNs(uint64_t ns_);
+	void advanceMs(uint64_t ms_) { advanceNs(ms_ * 1000000); }
+
+private:
+	std::atomic<uint64_t> mNowNs;
+};
+
+} // close namespace Kontrol
+} // close namespace pal
@@ -0,0 +1,135 @@
+#include "LatencyHistogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace pal::Kontrol;
+
+namespace {
+
+// index of the most significant set bit; v_ must not be 0.
+unsigned msb(uint64_t v_) {
+	unsigned r = 0;
+	for (unsigned shift = 32; shift > 0; shift >>= 1) {
+		if (v_ >> shift) {
+			v_ >>= shift;
+			r += shift;
+		}
+	}
+	return r;
+}
+
+} // close anonymous namespace
+
+// ------------------------------------------------------
+
+LatencyHistogram::LatencyHistogram() {
+	reset();
+}
+
+// ------------------------------------------------------
+
+size_t LatencyHistogram::bucketIndex(uint64_t ns_) {
+	// values below kSubBuckets get a bucket each. above, block b
+	// covers [2^(b+4), 2^(b+5)) in kSubBuckets steps of 2^(b-1).
+	if (ns_ < kSubBuckets)
+		return size_t(ns_);
+
+	const unsigned m = msb(ns_);
+	if (m >= kMaxValueBits)
+		return kNumBuckets - 1;
+
+	const size_t block = m - kSubBucketBits + 1;
+	const size_t sub   = size_t(ns_ >> (m - kSubBucketBits)) - kSubBuckets;
+	return block * kSubBuckets + sub;
+}
+
+// ------------------------------------------------------
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index_) {
+	const size_t block = index_ / kSubBuckets;
+	const size_t sub   = index_ % kSubBuckets;
+	if (block == 0)
+		return sub;
+
+	const unsigned shift = unsigned(block - 1);
+	return (uint64_t(kSubBuckets + sub + 1) << shift) - 1;
+}
+
+// ------------------------------------------------------
+
+void LatencyHistogram::record(uint64_t ns_, uint64_t count_) {
+	mBuckets[bucketIndex(ns_)].fetch_add(count_, std::memory_order_relaxed);
+	mCount.fetch_add(count_, std::memory_order_relaxed);
+	mSum.fetch_add(ns_ * count_, std::memory_order_relaxed);
+
+	uint64_t m = mMax.load(std::memory_order_relaxed);
+	while (ns_ > m && !mMax.compare_exchange_weak(m, ns_, std::memory_order_relaxed)) {
+	}
+}
+
+// ------------------------------------------------------
+
+uint64_t LatencyHistogram::count() const {
+	return mCount.load(std::memory_order_relaxed);
+}
+
+// ------------------------------------------------------
+
+uint64_t LatencyHistogram::max() const {
+	return mMax.load(std::memory_order_relaxed);
+}
+
+// ------------------------------------------------------
+
+double LatencyHistogram::mean() const {
+	const uint64_t n = count();
+	return n ? double(mSum.load(std::memory_order_relaxed)) / n : 0.;
+}
+
+// ------------------------------------------------------
+
+uint64_t LatencyHistogram::percentile(double percentile_) const {
+	const uint64_t n = count();
+	if (n == 0)
+		return 0;
+
+	// ----------| invariant: there is at least one value
+
+	const double p = percentile_ < 0. ? 0. : (percentile_ > 100. ? 100. : percentile_);
+	uint64_t rank = uint64_t(std::ceil(p / 100. * n));
+	if (rank == 0)
+		rank = 1;
+
+	uint64_t seen = 0;
+	for (size_t i = 0; i < kNumBuckets; ++i) {
+		seen += mBuckets[i].load(std::memory_order_relaxed);
+		if (seen >= rank)
+			return std::min(bucketUpperBound(i), max());
+	}
+	return max();
+}
+
+// ------------------------------------------------------
+
+void LatencyHistogram::reset() {
+	for (auto& b : mBuckets) {
+		b.store(0, std::memory_order_relaxed);
+	}
+	mCount.store(0, std::memory_order_relaxed);
+	mSum.store(0, std::memory_order_relaxed);
+	mMax.store(0, std::memory_order_relaxed);
+}
+
+// ------------------------------------------------------
+
+std::string LatencyHistogram::summary() const {
+	char line[200];
+	std::snprintf(line, sizeof(line),
+		"n=%llu mean=%.1fus p50=%.1fus p90=%.1fus p99=%.1fus p99.9=%.1fus max=%.1fus",
+		(unsigned long long)count(), mean() * 1e-3,
+		percentile(50.) * 1e-3, percentile(90.) * 1e-3, percentile(99.) * 1e-3,
+		percentile(99.9) * 1e-3, max() * 1e-3);
+	return line;
+}
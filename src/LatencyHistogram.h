@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace pal {
+namespace Kontrol {
+
+/*
+
+A histogram of latencies in nanoseconds, in the manner of an HDR 
+histogram: buckets are linear within each power of two, so that 
+every recorded value is kept to within 1/32 (~3%) of its size, 
+from 1ns up to ~73 minutes, in a fixed ~10KB.
+
+Recording is lock-free - a relaxed atomic increment - so any 
+number of threads may record while another one queries. Queries
+which race with recording see some of the racing values, which
+is fine for statistics.
+
+*/
+
+class LatencyHistogram
+{
+public:
+
+	static const unsigned kSubBucketBits = 5;
+	static const size_t   kSubBuckets    = size_t(1) << kSubBucketBits;
+	static const unsigned kMaxValueBits  = 42; ///< larger values are counted in the last bucket
+	static const size_t   kNumBuckets    = (kMaxValueBits - kSubBucketBits + 1) * kSubBuckets;
+
+	LatencyHistogram();
+
+	LatencyHistogram(const LatencyHistogram&) = delete;
+	LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+	// record count_ occurrences of a latency of ns_.
+	void record(uint64_t ns_, uint64_t count_ = 1);
+
+	uint64_t count() const;
+	uint64_t max() const;
+	double   mean() const;
+
+	// latency at or below which percentile_ (0..100) of the recorded
+	// values lie, to within the histogram's precision; 0 if empty.
+	uint64_t percentile(double percentile_) const;
+
+	// not atomic as a whole: values recorded meanwhile may be lost.
+	void reset();
+
+	// one line: count, mean, p50, p90, p99, p99.9 and max, in microseconds.
+	std::string summary() const;
+
+private:
+
+	static size_t   bucketIndex(uint64_t ns_);
+	static uint64_t bucketUpperBound(size_t index_);
+
+	std::array<std::atomic<uint64_t>, kNumBuckets> mBuckets;
+	std::atomic<uint64_t> mCount;
+	std::atomic<uint64_t> mSum;
+	std::atomic<uint64_t> mMax;
+};
+
+} // close namespace Kontrol
+} // close namespace pal
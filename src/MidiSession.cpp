@@ -0,0 +1,154 @@
+#include "MidiSession.h"
+
+#include <cstring>
+
+using namespace pal::Kontrol;
+
+namespace {
+
+struct Header {
+	char     magic[8];
+	uint32_t version;
+	uint32_t recordSize;
+};
+
+static_assert(sizeof(Header) == 16, "session header is 16 bytes");
+
+// ------------------------------------------------------
+
+bool isValid(const Header& h_) {
+	return std::memcmp(h_.magic, MidiSessionWriter::kMagic, sizeof(h_.magic)) == 0 &&
+		h_.version == MidiSessionWriter::kVersion &&
+		h_.recordSize == sizeof(MidiSessionRecord);
+}
+
+} // close anonymous namespace
+
+const char MidiSessionWriter::kMagic[8] = { 'T', 'W', 'S', 'T', 'S', 'E', 'S', 'S' };
+
+// ------------------------------------------------------
+
+MidiSessionWriter::~MidiSessionWriter() {
+	close();
+}
+
+// ------------------------------------------------------
+
+bool MidiSessionWriter::open(const std::string& path_, uint64_t startNs_) {
+	close();
+
+	// create the file if need be, without truncating it, then open it
+	// for writing anywhere: a partial record gets overwritten.
+	std::FILE* created = std::fopen(path_.c_str(), "ab");
+	if (created == nullptr)
+		return false;
+	std::fclose(created);
+
+	mFile = std::fopen(path_.c_str(), "r+b");
+	if (mFile == nullptr)
+		return false;
+
+	// ----------| invariant: file is open, for reading and writing
+
+	std::fseek(mFile, 0, SEEK_END);
+	const long size = std::ftell(mFile);
+
+	if (size == 0) {
+		Header h;
+		std::memcpy(h.magic, kMagic, sizeof(h.magic));
+		h.version    = kVersion;
+		h.recordSize = sizeof(MidiSessionRecord);
+		std::fwrite(&h, sizeof(h), 1, mFile);
+	} else {
+		Header h;
+		std::fseek(mFile, 0, SEEK_SET);
+		if (std::fread(&h, sizeof(h), 1, mFile) != 1 || !isValid(h)) {
+			close();
+			return false;
+		}
+
+		// ----------| invariant: we append to a valid session
+
+		// a crash may have left a partial record behind. we overwrite
+		// it with padding, rather than complete it, as its leading 
+		// bytes would otherwise replay as a message. switching from 
+		// reading to writing needs a seek, either way.
+		const long partial = (size - long(sizeof(Header))) % long(sizeof(MidiSessionRecord));
+		std::fseek(mFile, size - partial, SEEK_SET);
+		if (partial != 0) {
+			const MidiSessionRecord pad{};
+			std::fwrite(&pad, sizeof(pad), 1, mFile);
+		}
+	}
+
+	// a recording appended to a session has an epoch of its own.
+	MidiSessionRecord marker{};
+	marker.timeNs          = startNs_;
+	marker.command_channel = MidiSessionRecord::kSessionStart;
+	std::fwrite(&marker, sizeof(marker), 1, mFile);
+
+	return true;
+}
+
+// ------------------------------------------------------
+
+void MidiSessionWriter::close() {
+	if (mFile != nullptr) {
+		std::fclose(mFile);
+		mFile = nullptr;
+	}
+}
+
+// ------------------------------------------------------
+
+bool MidiSessionWriter::isOpen() const {
+	return mFile != nullptr;
+}
+
+// ------------------------------------------------------
+
+void MidiSessionWriter::append(const MidiSessionRecord* records_, size_t count_) {
+	if (mFile != nullptr && count_ > 0) {
+		std::fwrite(records_, sizeof(MidiSessionRecord), count_, mFile);
+	}
+}
+
+// ------------------------------------------------------
+
+void MidiSessionWriter::flush() {
+	if (mFile != nullptr) {
+		std::fflush(mFile);
+	}
+}
+
+// ------------------------------------------------------
+
+bool pal::Kontrol::readMidiSession(const std::string& path_, std::vector<MidiSessionRecord>& records_, std::string* error_) {
+
+	auto fail = [error_](const std::string& what_) {
+		if (error_) {
+			*error_ = what_;
+		}
+		return false;
+	};
+
+	records_.clear();
+
+	std::FILE* file = std::fopen(path_.c_str(), "rb");
+	if (file == nullptr)
+		return fail("could not open " + path_);
+
+	Header h;
+	if (std::fread(&h, sizeof(h), 1, file) != 1 || !isValid(h)) {
+		std::fclose(file);
+		return fail(path_ + " is not a midi session");
+	}
+
+	MidiSessionRecord r;
+	while (std::fread(&r, sizeof(r), 1, file) == 1) {
+		records_.push_back(r);
+	}
+
+	std::fclose(file);
+	return true;
+}
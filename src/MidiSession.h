@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace pal {
+namespace Kontrol {
+
+/*
+
+A recorded midi session: a compact, append-only binary log of the 
+controller messages that arrived from the twister.
+
+A session file is a 16 byte header - the magic "TWSTSESS", then 
+format version and record size as uint32 - followed by 16 byte 
+records, all in host byte order. Records are fixed-size, so a file
+can be mapped into memory and indexed directly, and a session cut 
+short by a crash loses at most its last, partial record. Appending
+to such a session overwrites the partial record with padding - a 
+record with a zero status byte, which replay skips.
+
+Each recording starts with a marker record, status byte 0xFF, stamped
+with the time the recording started. Recordings appended to one file
+each have their own clock epoch; replay starts each recording's 
+timeline afresh at its marker, right after the previous recording.
+
+*/
+
+struct MidiSessionRecord {
+	static const uint8_t kSessionStart = 0xFF; ///< status byte of a recording's start marker
+
+	uint64_t timeNs;          ///< arrival time, nanoseconds on the recording core's clock
+	uint8_t  command_channel;
+	uint8_t  controller;
+	uint8_t  value;
+	uint8_t  reserved[5];     ///< zero
+};
+
+static_assert(sizeof(MidiSessionRecord) == 16, "session records are 16 bytes");
+
+class MidiSessionWriter
+{
+public:
+
+	static const char     kMagic[8];
+	static const uint32_t kVersion = 1;
+
+	~MidiSessionWriter();
+
+	// open path_ for appending; a new or empty file gets a header.
+	// either way, a start marker stamped startNs_ follows. returns 
+	// false if the file can't be opened, or is not a session file.
+	bool open(const std::string& path_, uint64_t startNs_);
+	void close();
+	bool isOpen() const;
+
+	void append(const MidiSessionRecord* records_, size_t count_);
+	void flush();
+
+private:
+	std::FILE* mFile = nullptr;
+};
+
+// read all complete records of a session file. returns false, and
+// describes the problem in error_, if it is not a session file.
+bool readMidiSession(const std::string& path_, std::vector<MidiSessionRecord>& records_, std::string* error_ = nullptr);
+
+} // close namespace Kontrol
+} // close namespace pal
@@ -0,0 +1,126 @@
+#include "ResponseCurve.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace pal::Kontrol;
+
+// ------------------------------------------------------
+
+ResponseCurve::ResponseCurve()
+	: ResponseCurve(linear()) {
+}
+
+// ------------------------------------------------------
+
+ResponseCurve::ResponseCurve(Type type_)
+	: mType(type_) {
+	mForward.fill(0.f);
+}
+
+// ------------------------------------------------------
+
+template<typename Fn>
+ResponseCurve ResponseCurve::fromFunction(Type type_, Fn fn_) {
+	ResponseCurve c(type_);
+	for (size_t i = 0; i < kNumSteps; ++i) {
+		c.mForward[i] = fn_(float(i) / float(kNumSteps - 1));
+	}
+	// make sure the end points are exact, whatever the
+	// function's rounding error.
+	c.mForward.front() = 0.f;
+	c.mForward.back() = 1.f;
+	c.makeMonotonic();
+	return c;
+}
+
+// ------------------------------------------------------
+
+ResponseCurve ResponseCurve::linear() {
+	return fromFunction(Type::LINEAR, [](float t) {
+		return t;
+	});
+}
+
+// ------------------------------------------------------
+
+ResponseCurve ResponseCurve::logarithmic(float k_) {
+	k_ = std::max(k_, 1e-3f);
+	return fromFunction(Type::LOG, [k_](float t) {
+		return std::log1p(k_ * t) / std::log1p(k_);
+	});
+}
+
+// ------------------------------------------------------
+
+ResponseCurve ResponseCurve::exponential(float k_) {
+	k_ = std::max(k_, 1e-3f);
+	return fromFunction(Type::EXP, [k_](float t) {
+		return std::expm1(k_ * t) / std::expm1(k_);
+	});
+}
+
+// ------------------------------------------------------
+
+ResponseCurve ResponseCurve::power(float exponent_) {
+	exponent_ = std::max(exponent_, 1e-3f);
+	return fromFunction(Type::POWER, [exponent_](float t) {
+		return std::pow(t, exponent_);
+	});
+}
+
+// ------------------------------------------------------
+
+ResponseCurve ResponseCurve::sCurve(float steepness_) {
+	steepness_ = std::max(steepness_, 1e-3f);
+	// logistic function, rescaled so that it passes through (0,0) and (1,1)
+	auto logistic = [steepness_](float t) {
+		return 1.f / (1.f + std::exp(-steepness_ * (t - 0.5f)));
+	};
+	const float lo = logistic(0.f);
+	const float hi = logistic(1.f);
+	return fromFunction(Type::S_CURVE, [=](float t) {
+		return (logistic(t) - lo) / (hi - lo);
+	});
+}
+
+// ------------------------------------------------------
+
+ResponseCurve ResponseCurve::table(const Table& table_) {
+	ResponseCurve c(Type::TABLE);
+	for (size_t i = 0; i < kNumSteps; ++i) {
+		c.mForward[i] = std::min(std::max(table_[i], 0.f), 1.f);
+	}
+	c.makeMonotonic();
+	return c;
+}
+
+// ------------------------------------------------------
+
+void ResponseCurve::makeMonotonic() {
+	for (size_t i = 1; i < kNumSteps; ++i) {
+		mForward[i] = std::max(mForward[i], mForward[i - 1]);
+	}
+}
+
+// ------------------------------------------------------
+
+uint8_t ResponseCurve::toMidi(float n_) const {
+
+	// first entry which is not less than n_
+	auto it = std::lower_bound(mForward.begin(), mForward.end(), n_);
+
+	if (it == mForward.begin())
+		return 0;
+	if (it == mForward.end())
+		return uint8_t(kNumSteps - 1);
+
+	// ----------| invariant: n_ lies between *(it-1) and *it
+
+	// pick whichever neighbour is closer
+	auto prev = it - 1;
+	if ((n_ - *prev) < (*it - n_))
+		it = prev;
+
+	return uint8_t(it - mForward.begin());
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+namespace pal {
+namespace Kontrol {
+
+/*
+
+A response curve maps midi values (0..127) onto normalised
+parameter values (0..1), and back.
+
+The forward direction is a lookup into a precomputed table
+of 128 entries. The inverse direction is a binary search into
+that same table, so that a parameter value written back to the
+twister lands exactly on the step that produced it.
+
+Tables are kept monotonic (non-decreasing), which is what
+makes the binary search valid.
+
+*/
+
+class ResponseCurve
+{
+public:
+
+	enum class Type {
+		LINEAR,
+		LOG,     ///< fast rise at the start, fine control towards the top
+		EXP,     ///< fine control at the start - frequencies, gains
+		POWER,   ///< t^exponent
+		S_CURVE, ///< fine control at both ends
+		TABLE,   ///< user-supplied table
+	};
+
+	static const size_t kNumSteps = 128;
+	typedef std::array<float, kNumSteps> Table;
+
+	ResponseCurve(); ///< default is linear
+
+	static ResponseCurve linear();
+	static ResponseCurve logarithmic(float k_ = 9.f);
+	static ResponseCurve exponential(float k_ = 4.f);
+	static ResponseCurve power(float exponent_ = 2.f);
+	static ResponseCurve sCurve(float steepness_ = 8.f);
+
+	// user-supplied table: values get clamped to 0..1 and
+	// made monotonic before use.
+	static ResponseCurve table(const Table& table_);
+
+	Type getType() const {
+		return mType;
+	};
+
+	// midi value -> normalised parameter value
+	float toNormalised(uint8_t v_) const {
+		return mForward[v_ & 0x7F];
+	};
+
+	// normalised parameter value -> nearest midi value
+	uint8_t toMidi(float n_) const;
+
+private:
+
+	ResponseCurve(Type type_);
+
+	template<typename Fn>
+	static ResponseCurve fromFunction(Type type_, Fn fn_);
+
+	void makeMonotonic();
+
+	Type  mType = Type::LINEAR;
+	Table mForward;
+};
+
+} // close namespace Kontrol
+} // close namespace pal
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace pal {
+namespace Kontrol {
+
+/*
+
+A queue which hands values from one thread to another - the part of
+ofThreadChannel that the midi input path needs, so that it does not
+depend on openFrameworks.
+
+Any number of threads may send; values are received in the order
+they were sent.
+
+Values wait in a ring of slots which is allocated once, up front, so
+that handing over a value does not touch the allocator. A full
+channel refuses values, rather than grow.
+
+*/
+
+template <typename T>
+class ThreadChannel
+{
+public:
+
+	explicit ThreadChannel(size_t capacity_)
+		: mRing(capacity_ > 0 ? capacity_ : 1) {
+	}
+
+	// false, and value_ untouched, if the channel is full.
+	bool send(T&& value_) {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (mCount == mRing.size())
+				return false;
+			mRing[(mFront + mCount) % mRing.size()] = std::move(value_);
+			++mCount;
+		}
+		mCondition.notify_one();
+		return true;
+	}
+
+	bool send(const T& value_) {
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			if (mCount == mRing.size())
+				return false;
+			mRing[(mFront + mCount) % mRing.size()] = value_;
+			++mCount;
+		}
+		mCondition.notify_one();
+		return true;
+	}
+
+	// false, and value_ untouched, if nothing is waiting.
+	bool tryReceive(T& value_) {
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (mCount == 0)
+			return false;
+		pop(value_);
+		return true;
+	}
+
+	// wait up to timeoutMs_ for a value to arrive.
+	bool tryReceive(T& value_, int64_t timeoutMs_) {
+		std::unique_lock<std::mutex> lock(mMutex);
+		if (!mCondition.wait_for(lock, std::chrono::milliseconds(timeoutMs_), [this]() { return mCount != 0; }))
+			return false;
+		pop(value_);
+		return true;
+	}
+
+	bool empty() const {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mCount == 0;
+	}
+
+	size_t capacity() const {
+		return mRing.size();
+	}
+
+private:
+
+	// ----------| invariant: mutex is held, and a value is waiting
+	void pop(T& value_) {
+		value_ = std::move(mRing[mFront]);
+		mFront = (mFront + 1) % mRing.size();
+		--mCount;
+	}
+
+	mutable std::mutex      mMutex;
+	std::condition_variable mCondition;
+	std::vector<T>          mRing;
+	size_t                  mFront = 0;
+	size_t                  mCount = 0;
+};
+
+} // close namespace Kontrol
+} // close namespace pal
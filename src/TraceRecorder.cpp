@@ -0,0 +1,236 @@
+#include "TraceRecorder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+
+using namespace pal::Kontrol;
+
+namespace {
+
+std::atomic<uint64_t> gNextRecorderId{ 1 };
+
+// the calling thread's buffer, for the recorder it was last used with.
+struct ThreadCache {
+	uint64_t recorderId = 0;
+	void*    buffer     = nullptr;
+};
+
+thread_local ThreadCache tCache;
+
+// ------------------------------------------------------
+
+void writeJsonString(std::ostream& out_, const std::string& s_) {
+	out_ << '"';
+	for (char c : s_) {
+		if (c == '"' || c == '\\') {
+			out_ << '\\' << c;
+		} else if (uint8_t(c) < 0x20) {
+			char escaped[8];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", unsigned(c));
+			out_ << escaped;
+		} else {
+			out_ << c;
+		}
+	}
+	out_ << '"';
+}
+
+} // close anonymous namespace
+
+// ------------------------------------------------------
+
+TraceRecorder::Span::Span(TraceRecorder& recorder_, const char* name_, uint32_t arg_)
+	: mRecorder(recorder_.isEnabled() ? &recorder_ : nullptr)
+	, mName(name_)
+	, mBeginNs(mRecorder ? nowNs() : 0)
+	, mArg(arg_) {
+}
+
+// ------------------------------------------------------
+
+TraceRecorder::Span::~Span() {
+	if (mRecorder) {
+		mRecorder->complete(mName, mBeginNs, nowNs(), mArg);
+	}
+}
+
+// ------------------------------------------------------
+
+TraceRecorder::TraceRecorder(size_t eventsPerThread_)
+	: mCapacity(eventsPerThread_ > 0 ? eventsPerThread_ : 1)
+	, mId(gNextRecorderId.fetch_add(1, std::memory_order_relaxed)) {
+}
+
+// ------------------------------------------------------
+
+TraceRecorder::~TraceRecorder() {
+	setEnabled(false);
+}
+
+// ------------------------------------------------------
+
+void TraceRecorder::setEnabled(bool enabled_) {
+	mEnabled.store(enabled_, std::memory_order_relaxed);
+}
+
+// ------------------------------------------------------
+
+TraceRecorder::ThreadBuffer& TraceRecorder::threadBuffer() {
+	if (tCache.recorderId == mId)
+		return *static_cast<ThreadBuffer*>(tCache.buffer);
+
+	// ----------| invariant: this thread last recorded elsewhere, or never
+
+	std::lock_guard<std::mutex> lock(mBuffersMutex);
+
+	const std::thread::id self = std::this_thread::get_id();
+	auto it = std::find_if(mBuffers.begin(), mBuffers.end(), [self](const std::unique_ptr<ThreadBuffer>& b_) {
+		return b_->owner == self;
+	});
+
+	if (it == mBuffers.end()) {
+		// first event from this thread, for this recorder
+		std::unique_ptr<ThreadBuffer> buffer(new ThreadBuffer);
+		buffer->tid   = uint32_t(mBuffers.size() + 1);
+		buffer->owner = self;
+		buffer->slots.reset(new Slot[mCapacity]);
+		mBuffers.push_back(std::move(buffer));
+		it = mBuffers.end() - 1;
+	}
+
+	tCache.recorderId = mId;
+	tCache.buffer     = it->get();
+	return **it;
+}
+
+// ------------------------------------------------------
+
+void TraceRecorder::record(const Event& e_) {
+	ThreadBuffer& b = threadBuffer();
+	const uint64_t w = b.written.load(std::memory_order_relaxed);
+	Slot& s = b.slots[w % mCapacity];
+
+	s.seq.store(2 * w + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	s.name.store(e_.name, std::memory_order_relaxed);
+	s.beginNs.store(e_.beginNs, std::memory_order_relaxed);
+	s.endNs.store(e_.endNs, std::memory_order_relaxed);
+	s.arg.store(e_.arg, std::memory_order_relaxed);
+	s.instant.store(e_.instant, std::memory_order_relaxed);
+
+	s.seq.store(2 * (w + 1), std::memory_order_release);
+	b.written.store(w + 1, std::memory_order_release);
+}
+
+// ------------------------------------------------------
+
+void TraceRecorder::complete(const char* name_, uint64_t beginNs_, uint64_t endNs_, uint32_t arg_) {
+	if (!isEnabled())
+		return;
+	record({ name_, beginNs_, endNs_ < beginNs_ ? beginNs_ : endNs_, arg_, false });
+}
+
+// ------------------------------------------------------
+
+void TraceRecorder::instant(const char* name_, uint64_t timeNs_, uint32_t arg_) {
+	if (!isEnabled())
+		return;
+	record({ name_, timeNs_, timeNs_, arg_, true });
+}
+
+// ------------------------------------------------------
+
+void TraceRecorder::setThreadName(const std::string& name_) {
+	ThreadBuffer& b = threadBuffer();
+
+	// only this thread writes its name, so it may read it unlocked.
+	if (b.name == name_)
+		return;
+
+	std::lock_guard<std::mutex> lock(mBuffersMutex);
+	b.name = name_;
+}
+
+// ------------------------------------------------------
+
+void TraceRecorder::writeChromeTrace(std::ostream& out_) const {
+	std::lock_guard<std::mutex> lock(mBuffersMutex);
+
+	out_ << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	bool first = true;
+	char line[128];
+
+	for (const auto& b : mBuffers) {
+		if (!b->name.empty()) {
+			out_ << (first ? "\n" : ",\n");
+			first = false;
+			out_ << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << b->tid << ",\"args\":{\"name\":";
+			writeJsonString(out_, b->name);
+			out_ << "}}";
+		}
+
+		const uint64_t end = b->written.load(std::memory_order_acquire);
+		const uint64_t begin = std::max(end > mCapacity ? end - mCapacity : 0,
+			b->cleared.load(std::memory_order_relaxed));
+
+		for (uint64_t i = begin; i < end; ++i) {
+			Event e;
+			if (!readEvent(b->slots[i % mCapacity], i, e))
+				continue; // overwritten since we loaded end
+
+			out_ << (first ? "\n" : ",\n");
+			first = false;
+			out_ << "{\"name\":";
+			writeJsonString(out_, e.name);
+			if (e.instant) {
+				std::snprintf(line, sizeof(line), ",\"ph\":\"i\",\"s\":\"t\",\"ts\":%.3f", e.beginNs * 1e-3);
+			} else {
+				std::snprintf(line, sizeof(line), ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f", e.beginNs * 1e-3, (e.endNs - e.beginNs) * 1e-3);
+			}
+			out_ << line << ",\"pid\":1,\"tid\":" << b->tid << ",\"args\":{\"value\":" << e.arg << "}}";
+		}
+	}
+
+	out_ << "\n]}\n";
+}
+
+// ------------------------------------------------------
+
+bool TraceRecorder::readEvent(const Slot& s_, uint64_t index_, Event& e_) {
+	const uint64_t seq = s_.seq.load(std::memory_order_acquire);
+
+	e_.name    = s_.name.load(std::memory_order_relaxed);
+	e_.beginNs = s_.beginNs.load(std::memory_order_relaxed);
+	e_.endNs   = s_.endNs.load(std::memory_order_relaxed);
+	e_.arg     = s_.arg.load(std::memory_order_relaxed);
+	e_.instant = s_.instant.load(std::memory_order_relaxed);
+
+	// the slot held event index_ throughout, if its sequence
+	// number did not change while we read it.
+	std::atomic_thread_fence(std::memory_order_acquire);
+	return seq == 2 * (index_ + 1) && s_.seq.load(std::memory_order_relaxed) == seq;
+}
+
+// ------------------------------------------------------
+
+bool TraceRecorder::writeChromeTrace(const std::string& path_) const {
+	std::ofstream file(path_, std::ios::trunc);
+	if (!file)
+		return false;
+	writeChromeTrace(file);
+	return bool(file);
+}
+
+// ------------------------------------------------------
+
+void TraceRecorder::clear() {
+	std::lock_guard<std::mutex> lock(mBuffersMutex);
+	// writers own their write index, so rather than resetting it,
+	// we remember where it stood.
+	for (auto& b : mBuffers) {
+		b->cleared.store(b->written.load(std::memory_order_acquire), std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Clock.h"
+
+namespace pal {
+namespace Kontrol {
+
+/*
+
+Records spans and instant events from any number of threads, for
+export as Chrome trace JSON - to be opened in chrome://tracing, or
+ui.perfetto.dev.
+
+Each thread writes into a buffer of its own, a ring which keeps the
+most recent events, so recording takes no locks: a thread's first
+event registers its buffer, under a mutex, and all later events 
+are relaxed stores, fenced by a sequence number per slot, and one
+release store of the write index. Export reads each slot's sequence
+number before and after it copies the event, and leaves out events
+which were overwritten meanwhile - so it never reads an event that
+is half written. A thread
+which records into several recorders looks its buffer up again, 
+under the mutex, whenever it switches recorders. While disabled, 
+recording costs a relaxed load.
+
+Event names are not copied: they must be string literals, or 
+otherwise outlive the recorder.
+
+Spans are timed on SteadyClock, the same clock RtMidi stamps device
+input with, as they profile what the code really costs. Instant events
+carry whatever time they are given - midi arrivals carry their
+message's stamp, which is on the core's clock (see Clock.h). Under a
+VirtualClock, the two are on different timelines.
+
+*/
+
+class TraceRecorder
+{
+public:
+
+	// one span, from construction to destruction, if the
+	// recorder was enabled when the span began.
+	class Span {
+	public:
+		Span(TraceRecorder& recorder_, const char* name_, uint32_t arg_ = 0);
+		~Span();
+
+		Span(const Span&) = delete;
+		Span& operator=(const Span&) = delete;
+
+		void setArg(uint32_t arg_) {
+			mArg = arg_;
+		}
+
+	private:
+		TraceRecorder* mRecorder;
+		const char*    mName;
+		uint64_t       mBeginNs;
+		uint32_t       mArg;
+	};
+
+	explicit TraceRecorder(size_t eventsPerThread_ = 1 << 16);
+	~TraceRecorder();
+
+	TraceRecorder(const TraceRecorder&) = delete;
+	TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+	void setEnabled(bool enabled_);
+
+	bool isEnabled() const {
+		return mEnabled.load(std::memory_order_relaxed);
+	}
+
+	// the time spans are stamped with.
+	static uint64_t nowNs() {
+		return SteadyClock::instance().nowNs();
+	}
+
+	void complete(const char* name_, uint64_t beginNs_, uint64_t endNs_, uint32_t arg_ = 0);
+	void instant(const char* name_, uint64_t timeNs_, uint32_t arg_ = 0);
+
+	// name the calling thread, in the exported trace.
+	void setThreadName(const std::string& name_);
+
+	// export the events recorded so far. threads may keep recording 
+	// meanwhile; events they overwrite during export are left out.
+	void writeChromeTrace(std::ostream& out_) const;
+	bool writeChromeTrace(const std::string& path_) const;
+
+	// forget the events recorded so far. threads may keep recording
+	// meanwhile; events they record during the clear may survive it.
+	void clear();
+
+private:
+
+	struct Event {
+		const char* name;
+		uint64_t    beginNs;
+		uint64_t    endNs;   ///< equal to beginNs for instant events
+		uint32_t    arg;
+		bool        instant;
+	};
+
+	// an event, as the owning thread writes it, and other threads
+	// read it: seq is odd while the slot is being written, and
+	// 2 * (i + 1) once it holds the thread's i-th event.
+	struct Slot {
+		std::atomic<uint64_t>    seq{ 0 };
+		std::atomic<const char*> name{ nullptr };
+		std::atomic<uint64_t>    beginNs{ 0 };
+		std::atomic<uint64_t>    endNs{ 0 };
+		std::atomic<uint32_t>    arg{ 0 };
+		std::atomic<bool>        instant{ false };
+	};
+
+	struct ThreadBuffer {
+		uint32_t                tid;
+		std::thread::id         owner;
+		std::string             name;
+		std::unique_ptr<Slot[]> slots;
+		std::atomic<uint64_t> written{ 0 }; ///< only ever grows, written by the owner
+		std::atomic<uint64_t> cleared{ 0 }; ///< events before this index were cleared
+	};
+
+	ThreadBuffer& threadBuffer();
+	void record(const Event& e_);
+	static bool readEvent(const Slot& s_, uint64_t index_, Event& e_); ///< false if the slot does not hold event index_ (any more)
+
+	const size_t          mCapacity;
+	const uint64_t        mId; ///< tells recorders apart in per-thread caches
+	std::atomic<bool>     mEnabled{ false };
+
+	mutable std::mutex                         mBuffersMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> mBuffers;
+};
+
+} // close namespace Kontrol
+} // close namespace pal
@@ -0,0 +1,297 @@
+#include "TwisterConfig.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+using namespace pal::Kontrol;
+
+namespace {
+
+typedef uint8_t TwisterConfig::Encoder::*EncoderField;
+
+// encoder fields, indexed by tag - kFirstEncoderTag.
+const uint8_t kFirstEncoderTag = 0x0a;
+const std::array<EncoderField, 14> kEncoderFields{ {
+	&TwisterConfig::Encoder::hasDetent,
+	&TwisterConfig::Encoder::movement,
+	&TwisterConfig::Encoder::switchActionType,
+	&TwisterConfig::Encoder::switchMidiChannel,
+	&TwisterConfig::Encoder::switchMidiNumber,
+	&TwisterConfig::Encoder::switchMidiType,
+	&TwisterConfig::Encoder::encoderMidiChannel,
+	&TwisterConfig::Encoder::encoderMidiNumber,
+	&TwisterConfig::Encoder::encoderMidiType,
+	&TwisterConfig::Encoder::activeColor,
+	&TwisterConfig::Encoder::inactiveColor,
+	&TwisterConfig::Encoder::detentColor,
+	&TwisterConfig::Encoder::indicatorDisplayType,
+	&TwisterConfig::Encoder::isSuperKnob,
+} };
+
+// record header: type, slot, total, index, size of the (tag, value) pairs
+const size_t  kRecordHeaderSize = 5;
+const uint8_t kRecordPush       = 0x00;
+const uint8_t kRecordPull       = 0x01;
+const uint8_t kNumSlots         = 64;
+
+// ------------------------------------------------------
+
+bool parseRecord(const uint8_t* bytes_, size_t size_, TwisterConfig::Encoder& e_) {
+	if (size_ < kRecordHeaderSize || bytes_[0] != kRecordPush) {
+		return false;
+	}
+
+	size_t len = bytes_[4];
+	if (len % 2 != 0 || kRecordHeaderSize + len > size_) {
+		return false;
+	}
+
+	e_ = TwisterConfig::Encoder();
+	e_.slot = bytes_[1];
+	if (e_.slot < 1 || e_.slot > kNumSlots) {
+		return false;
+	}
+
+	for (const uint8_t* p = bytes_ + kRecordHeaderSize; p < bytes_ + kRecordHeaderSize + len; p += 2) {
+		size_t field = size_t(p[0]) - kFirstEncoderTag;
+		if (p[0] >= kFirstEncoderTag && field < kEncoderFields.size()) {
+			e_.*kEncoderFields[field] = p[1];
+		} else {
+			e_.extra.push_back({ p[0], p[1] });
+		}
+	}
+	return true;
+}
+
+// ------------------------------------------------------
+
+std::vector<uint8_t> sysex(uint8_t command_, const std::vector<uint8_t>& payload_) {
+	std::vector<uint8_t> msg;
+	msg.reserve(payload_.size() + 6);
+	msg.push_back(0xF0);
+	msg.insert(msg.end(), std::begin(TwisterConfig::kSysexManufacturer), std::end(TwisterConfig::kSysexManufacturer));
+	msg.push_back(command_);
+	msg.insert(msg.end(), payload_.begin(), payload_.end());
+	msg.push_back(0xF7);
+	return msg;
+}
+
+// ------------------------------------------------------
+
+void setGlobal(std::vector<TwisterConfig::Setting>& globals_, const TwisterConfig::Setting& s_) {
+	auto it = std::find_if(globals_.begin(), globals_.end(), [&s_](const TwisterConfig::Setting& g) {
+		return g.tag == s_.tag;
+	});
+	if (it != globals_.end()) {
+		it->value = s_.value;
+	} else {
+		globals_.push_back(s_);
+	}
+}
+
+} // close anonymous namespace
+
+const uint8_t TwisterConfig::kSysexManufacturer[3] = { 0x00, 0x01, 0x79 };
+
+// ------------------------------------------------------
+
+std::vector<uint8_t> TwisterConfig::Encoder::record() const {
+	std::vector<uint8_t> r{ kRecordPush, slot, 0x01, 0x00, 0x00 };
+	for (size_t i = 0; i < kEncoderFields.size(); ++i) {
+		r.push_back(uint8_t(kFirstEncoderTag + i));
+		r.push_back(this->*kEncoderFields[i]);
+	}
+	for (const auto& s : extra) {
+		r.push_back(s.tag);
+		r.push_back(s.value);
+	}
+	r[4] = uint8_t(r.size() - kRecordHeaderSize);
+	return r;
+}
+
+// ------------------------------------------------------
+
+bool TwisterConfig::parse(const std::vector<uint8_t>& bytes_, std::string* error_) {
+
+	auto fail = [error_](const char* what_) {
+		if (error_) {
+			*error_ = what_;
+		}
+		return false;
+	};
+
+	globals.clear();
+	encoders.clear();
+
+	// everything ends up in sysex data bytes, which are 7 bit.
+	if (std::any_of(bytes_.begin(), bytes_.end(), [](uint8_t b) { return b > 0x7F; })) {
+		return fail("value out of 7 bit range");
+	}
+
+	if (bytes_.size() < 2 || bytes_[0] != 0x00) {
+		return fail("missing header");
+	}
+
+	size_t pos = 2;
+	const size_t globalsEnd = pos + bytes_[1];
+	if (bytes_[1] % 2 != 0 || globalsEnd > bytes_.size()) {
+		return fail("truncated global settings");
+	}
+	for (; pos < globalsEnd; pos += 2) {
+		globals.push_back({ bytes_[pos], bytes_[pos + 1] });
+	}
+
+	while (pos < bytes_.size()) {
+		Encoder e;
+		if (!parseRecord(&bytes_[pos], bytes_.size() - pos, e)) {
+			return fail("malformed encoder record");
+		}
+		pos += kRecordHeaderSize + bytes_[pos + 4];
+		encoders.push_back(std::move(e));
+	}
+
+	return true;
+}
+
+// ------------------------------------------------------
+
+bool TwisterConfig::load(const std::string& path_, std::string* error_) {
+	std::ifstream file(path_, std::ios::binary);
+	if (!file) {
+		if (error_) {
+			*error_ = "could not open " + path_;
+		}
+		return false;
+	}
+	std::vector<uint8_t> bytes{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+	return parse(bytes, error_);
+}
+
+// ------------------------------------------------------
+
+std::vector<uint8_t> TwisterConfig::serialize() const {
+	std::vector<uint8_t> bytes{ 0x00, uint8_t(globals.size() * 2) };
+	for (const auto& s : globals) {
+		bytes.push_back(s.tag);
+		bytes.push_back(s.value);
+	}
+	for (const auto& e : encoders) {
+		auto r = e.record();
+		bytes.insert(bytes.end(), r.begin(), r.end());
+	}
+	return bytes;
+}
+
+// ------------------------------------------------------
+
+uint64_t TwisterConfig::hash() const {
+	uint64_t h = 14695981039346656037ULL;
+	for (uint8_t b : serialize()) {
+		h ^= b;
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+// ------------------------------------------------------
+
+std::vector<std::vector<uint8_t>> TwisterConfig::toSysex() const {
+	std::vector<std::vector<uint8_t>> messages;
+	messages.reserve(encoders.size() + 1);
+
+	std::vector<uint8_t> pairs;
+	for (const auto& s : globals) {
+		pairs.push_back(s.tag);
+		pairs.push_back(s.value);
+	}
+	messages.push_back(sysex(PUSH_CONF, pairs));
+
+	for (const auto& e : encoders) {
+		messages.push_back(sysex(BULK_XFER, e.record()));
+	}
+	return messages;
+}
+
+// ------------------------------------------------------
+
+std::vector<uint8_t> TwisterConfig::pullGlobalsRequest() {
+	return sysex(PULL_CONF, {});
+}
+
+// ------------------------------------------------------
+
+std::vector<uint8_t> TwisterConfig::pullEncoderRequest(uint8_t slot_) {
+	// a record header without settings, marked as a request.
+	return sysex(BULK_XFER, { kRecordPull, slot_, 0x01, 0x00, 0x00 });
+}
+
+// ------------------------------------------------------
+
+bool TwisterConfig::applySysexReply(const std::vector<uint8_t>& message_) {
+
+	const size_t headerSize = 1 + sizeof(kSysexManufacturer) + 1;
+	if (message_.size() < headerSize + 1 ||
+		message_.front() != 0xF0 || message_.back() != 0xF7 ||
+		!std::equal(std::begin(kSysexManufacturer), std::end(kSysexManufacturer), message_.begin() + 1)) {
+		return false;
+	}
+
+	const uint8_t* payload = message_.data() + headerSize;
+	const size_t payloadSize = message_.size() - headerSize - 1;
+
+	switch (message_[headerSize - 1]) {
+	case PUSH_CONF:
+	case PULL_CONF:
+		// global settings, as (tag, value) pairs
+		if (payloadSize % 2 != 0) {
+			return false;
+		}
+		for (size_t i = 0; i < payloadSize; i += 2) {
+			setGlobal(globals, { payload[i], payload[i + 1] });
+		}
+		return true;
+	case BULK_XFER: {
+		Encoder e;
+		if (!parseRecord(payload, payloadSize, e)) {
+			return false;
+		}
+		auto it = std::find_if(encoders.begin(), encoders.end(), [&e](const Encoder& x) {
+			return x.slot == e.slot;
+		});
+		if (it != encoders.end()) {
+			*it = std::move(e);
+		} else {
+			encoders.push_back(std::move(e));
+		}
+		return true;
+	}
+	default:
+		return false;
+	}
+}
+
+// ------------------------------------------------------
+
+bool TwisterConfig::matches(const TwisterConfig& other_) const {
+
+	for (const auto& s : globals) {
+		auto it = std::find_if(other_.globals.begin(), other_.globals.end(), [&s](const Setting& o) {
+			return o.tag == s.tag;
+		});
+		if (it == other_.globals.end() || it->value != s.value) {
+			return false;
+		}
+	}
+
+	for (const auto& e : encoders) {
+		auto it = std::find_if(other_.encoders.begin(), other_.encoders.end(), [&e](const Encoder& o) {
+			return o.slot == e.slot;
+		});
+		if (it == other_.encoders.end() || it->record() != e.record()) {
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,106 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace pal {
+namespace Kontrol {
+
+/*
+
+Device configuration of a Midi Fighter Twister, as saved by the
+Midi Fighter Utility into a .mfs file (see data/mapping.mfs).
+
+An .mfs file holds:
+
+	- a two byte header: 0x00, and the size of the global settings
+	- global settings, as (tag, value) byte pairs
+	- one record per encoder slot (4 banks x 16 encoders), each a
+	  five byte header: 0x00, slot (1..64), 0x01, 0x00, size -
+	  followed by the encoder settings as (tag, value) byte pairs
+
+Over sysex (manufacturer id 00 01 79), global settings travel in a
+PUSH_CONF message, and encoder records - header included - travel
+verbatim in BULK_XFER messages.
+
+All values are 7 bit, as they must fit into sysex data bytes.
+
+*/
+
+struct TwisterConfig
+{
+	static const uint8_t kSysexManufacturer[3];
+
+	enum SysexCommand : uint8_t {
+		PUSH_CONF = 0x01,
+		PULL_CONF = 0x02,
+		SYSTEM    = 0x03,
+		BULK_XFER = 0x04,
+	};
+
+	struct Setting {
+		uint8_t tag;
+		uint8_t value;
+	};
+
+	// encoder settings, one field per tag (0x0a..0x17), in tag order.
+	// flags are stored as 0 or 1.
+	struct Encoder {
+		uint8_t slot = 0; ///< 1..64
+
+		uint8_t hasDetent            = 0;
+		uint8_t movement             = 0;
+		uint8_t switchActionType     = 0;
+		uint8_t switchMidiChannel    = 0; ///< 1-based
+		uint8_t switchMidiNumber     = 0;
+		uint8_t switchMidiType       = 0;
+		uint8_t encoderMidiChannel   = 0; ///< 1-based
+		uint8_t encoderMidiNumber    = 0;
+		uint8_t encoderMidiType      = 0;
+		uint8_t activeColor          = 0;
+		uint8_t inactiveColor        = 0;
+		uint8_t detentColor          = 0;
+		uint8_t indicatorDisplayType = 0;
+		uint8_t isSuperKnob          = 0;
+
+		std::vector<Setting> extra; ///< tags we don't know, kept so that they survive a round trip
+
+		// the encoder's record, header included, as in .mfs and BULK_XFER.
+		std::vector<uint8_t> record() const;
+	};
+
+	std::vector<Setting> globals;
+	std::vector<Encoder> encoders;
+
+	// parse .mfs content. returns false, and describes
+	// the problem in error_, if the content is malformed.
+	bool parse(const std::vector<uint8_t>& bytes_, std::string* error_ = nullptr);
+	bool load(const std::string& path_, std::string* error_ = nullptr);
+
+	// .mfs content; parse(serialize()) gives back the same config.
+	std::vector<uint8_t> serialize() const;
+
+	// 64 bit FNV-1a hash of serialize()
+	uint64_t hash() const;
+
+	// sysex messages which upload this config, globals first.
+	std::vector<std::vector<uint8_t>> toSysex() const;
+
+	// sysex requests, to read back the globals, or an encoder's record.
+	static std::vector<uint8_t> pullGlobalsRequest();
+	static std::vector<uint8_t> pullEncoderRequest(uint8_t slot_);
+
+	// apply a reply to a pull request to this config. returns false
+	// if the message is not a reply we understand.
+	bool applySysexReply(const std::vector<uint8_t>& message_);
+
+	// true if every setting in this config has the same value in other_.
+	// settings which other_ does not carry compare as different.
+	bool matches(const TwisterConfig& other_) const;
+};
+
+} // close namespace Kontrol
+} // close namespace pal
@@ -0,0 +1,1628 @@
+#include "TwisterCore.h"
+
+#include "RtMidi.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+
+using namespace pal::Kontrol;
+
+namespace {
+
+// the twister has 16 encoders in each of four banks.
+const uint8_t kEncodersPerDevice = 64;
+
+// sysex configuration transfer: the device needs a moment to
+// store each batch of messages.
+const size_t   kSysexBatchSize     = 8;
+const int      kSysexBatchPauseMs  = 20;
+const uint64_t kReadBackTimeoutMs  = 1000;
+const uint64_t kReadBackPollMs     = 1;
+
+const char* kLatencyStageNames[] = {
+	"driver -> callback",
+	"callback -> dequeue",
+	"dequeue -> apply",
+	"end to end",
+};
+
+// ------------------------------------------------------
+
+uint64_t elapsedNs(uint64_t from_, uint64_t to_) {
+	// stamps from different sources may be slightly out of order.
+	return to_ > from_ ? to_ - from_ : 0;
+}
+
+// ------------------------------------------------------
+
+// the loopback input's time source: whichever clock the core
+// goes by at the time, see TwisterCore::setClock
+uint64_t channelNowNs(void* channels_) {
+	return static_cast<MidiInChannels*>(channels_)->clock.load(std::memory_order_relaxed)->nowNs();
+}
+
+// ------------------------------------------------------
+
+// as ofMap(v_, inMin_, inMax_, outMin_, outMax_, true)
+float mapClamped(float v_, float inMin_, float inMax_, float outMin_, float outMax_) {
+	if (std::fabs(inMin_ - inMax_) < std::numeric_limits<float>::epsilon()) {
+		return outMin_;
+	}
+	const float t = std::min(1.f, std::max(0.f, (v_ - inMin_) / (inMax_ - inMin_)));
+	return outMin_ + (outMax_ - outMin_) * t;
+}
+
+// ------------------------------------------------------
+
+uint64_t readConfigHash(const std::string& path_) {
+	uint64_t hash = 0;
+	std::ifstream file(path_);
+	file >> std::hex >> hash;
+	return hash;
+}
+
+// ------------------------------------------------------
+
+void writeConfigHash(const std::string& path_, uint64_t hash_) {
+	std::ofstream file(path_, std::ios::trunc);
+	file << std::hex << hash_;
+}
+
+// ------------------------------------------------------
+
+// increment a counter which only one thread writes - 
+// cheaper than an atomic read-modify-write.
+void bump(std::atomic<uint64_t>& counter_, uint64_t n_ = 1) {
+	counter_.store(counter_.load(std::memory_order_relaxed) + n_, std::memory_order_relaxed);
+}
+
+// ------------------------------------------------------
+
+// send a message, and count it - or that it could not be sent.
+// with delaySeconds_ >= 0, the message is scheduled instead.
+void sendCounted(RtMidiOut* out_, const unsigned char* msg_, size_t size_, MidiInChannels& shared_, double delaySeconds_ = -1.0) {
+	TwisterStats& stats_ = shared_.stats;
+	TraceRecorder::Span span(shared_.trace, "midi send", uint32_t(size_));
+
+	if (!out_->isPortOpen()) {
+		bump(stats_.sendErrors);
+		return;
+	}
+
+	// ----------| invariant: port is open
+
+	try {
+		if (delaySeconds_ < 0.0) {
+			// sends from a buffer the port reuses: no allocation.
+			out_->sendMessage(msg_, size_);
+		} else {
+			std::vector<unsigned char> msg(msg_, msg_ + size_);
+			out_->scheduleMessage(&msg, delaySeconds_);
+		}
+		bump(stats_.sent);
+		bump(stats_.bytesOut, size_);
+	}
+	catch (RtMidiError& error) {
+		bump(stats_.sendErrors);
+		error.printMessage();
+	}
+}
+
+// ------------------------------------------------------
+
+// hand a batch over to update(), and reset it.
+void enqueue(MidiInChannels& ch_, MidiCCBatch& batch_) {
+	// count before sending, so that update() never sees more 
+	// messages received than queued.
+	const uint64_t queued = ch_.stats.queued.fetch_add(batch_.count, std::memory_order_relaxed) + batch_.count;
+	if (queued > ch_.stats.queueHighWater.load(std::memory_order_relaxed)) {
+		ch_.stats.queueHighWater.store(queued, std::memory_order_relaxed);
+	}
+
+	if (!ch_.controller.send(std::move(batch_))) {
+		ch_.stats.queued.fetch_sub(batch_.count, std::memory_order_relaxed);
+		bump(ch_.stats.dropped, batch_.count);
+	}
+	batch_.count = 0;
+}
+
+// ------------------------------------------------------
+/// \brief		static callback for midi controller
+/// \detail		all this callback does is translate the messages into midi message objects
+/// and then pass them on to the midi in thread channel, one batch at a time,
+/// so they can be processed in update.
+void onMidiInput(const RtMidiMessage *messages, unsigned int count, void *channels)
+{
+	auto ch = static_cast<MidiInChannels*>(channels);
+
+	MidiCCBatch batch;
+	std::array<uint32_t, 16> received{};
+	uint32_t rejected = 0;
+
+	const bool tracing = ch->trace.isEnabled();
+	if (tracing) {
+		ch->trace.setThreadName("midi input");
+	}
+	TraceRecorder::Span span(ch->trace, "midi callback", count);
+
+	const bool trackLatency = ch->latency.enabled.load(std::memory_order_relaxed);
+	if (trackLatency) {
+		batch.callbackNs = ch->clock.load(std::memory_order_relaxed)->nowNs();
+	}
+
+	for (unsigned int i = 0; i < count; ++i) {
+
+		const unsigned char* bytes = messages[i].data();
+		const size_t size = messages[i].size();
+
+		if (size > 3 && bytes[0] == 0xF0) {
+			if (ch->sysexWanted) {
+				if (!ch->sysex.send(std::vector<uint8_t>(bytes, bytes + size))) {
+					bump(ch->stats.dropped);
+				}
+			} else {
+				++rejected;
+			}
+			continue;
+		}
+
+		// anything but a well-formed controller message stops here,
+		// so that everything after can trust what it gets.
+		MidiCCMessage& msg = batch.messages[batch.count];
+		if (!msg.decode(bytes, size)) {
+			++rejected;
+			continue;
+		}
+
+		++batch.count;
+		msg.timeNs = messages[i].timeNs;
+		++received[msg.getChannel()];
+
+		if (tracing && msg.timeNs != 0) {
+			ch->trace.instant("midi arrival", msg.timeNs, msg.controller);
+		}
+
+		if (trackLatency && msg.timeNs != 0) {
+			ch->latency[LatencyStage::DRIVER_TO_CALLBACK].record(elapsedNs(msg.timeNs, batch.callbackNs));
+		}
+
+		// only format the message if it is going to be logged, 
+		// so that the common path does not allocate.
+		if (isTwisterLogged(TWISTER_LOG_VERBOSE)) {
+			std::ostringstream ostr;
+			ostr
+				<< std::hex << 1 * msg.getCommand() << " : "
+				<< std::hex << 1 * msg.getChannel() << " : "
+				<< std::hex << 1 * msg.controller << " : "
+				<< std::hex << 1 * msg.value;
+
+			TwisterLog(TWISTER_LOG_VERBOSE) << ostr.str();
+		}
+
+		if (batch.count == MidiCCBatch::kCapacity) {
+			enqueue(*ch, batch);
+		}
+	}
+
+	if (batch.count > 0) {
+		enqueue(*ch, batch);
+	}
+
+	for (size_t c = 0; c < received.size(); ++c) {
+		if (received[c]) {
+			bump(ch->stats.received[c], received[c]);
+		}
+	}
+	if (rejected) {
+		bump(ch->stats.rejected, rejected);
+	}
+}
+
+} // close anonymous namespace
+
+// ------------------------------------------------------
+
+TwisterCore::~TwisterCore() {
+	if (mMidiIn != nullptr) {
+		mMidiIn->closePort();
+		delete mMidiIn;
+		mMidiIn = nullptr;
+	}
+	if (mMidiOut != nullptr) {
+		mMidiOut->closePort();
+		delete mMidiOut;
+		mMidiOut = nullptr;
+	}
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::setClock(Clock* clock_) {
+	mChannelMidiIn.clock.store(clock_ ? clock_ : &SteadyClock::instance(), std::memory_order_relaxed);
+}
+
+// ------------------------------------------------------
+
+Clock& TwisterCore::clock() const {
+	return *mChannelMidiIn.clock.load(std::memory_order_relaxed);
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::setRealtimeInput(bool enabled_, int priority_, int cpu_) {
+	mRealtimeInput.enabled  = enabled_;
+	mRealtimeInput.priority = priority_;
+	mRealtimeInput.cpu      = cpu_;
+}
+
+// ------------------------------------------------------
+
+bool TwisterCore::isInputRealtime() const {
+	return mInputRealtime;
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::setup(RtMidi::Api api_) {
+
+	// calling setup() again re-connects.
+	bool reconnect = false;
+	if (mMidiIn != nullptr) {
+		reconnect = mMidiIn->isPortOpen();
+		mMidiIn->closePort();
+		delete mMidiIn;
+		mMidiIn = nullptr;
+	}
+
+	// establish midi in connection,
+	// and bind callback for midi in.
+	try {
+		mMidiIn = new RtMidiIn(api_);
+		size_t numPorts = mMidiIn->getPortCount();
+		size_t midiPort = -1;
+		const std::string deviceName("Midi Fighter Twister");
+		if (mMidiIn->getPortCount() >= 1)
+		{
+			for (size_t i = 0; i < numPorts; ++i)
+			{
+				if (mMidiIn->getPortName(i).substr(0, deviceName.size()) == deviceName)
+				{
+					midiPort = i;
+					if (reconnect)
+						bump(mChannelMidiIn.stats.reconnects);
+					mMidiIn->setRealtimeScheduling(mRealtimeInput.enabled, mRealtimeInput.priority, mRealtimeInput.cpu);
+					// loopback input is stamped with our clock, which may
+					// be virtual; other apis stamp input themselves.
+					mMidiIn->setTimeSource(&channelNowNs, &mChannelMidiIn);
+					mMidiIn->openPort(midiPort);
+					mMidiIn->setBatchCallback(&onMidiInput, &mChannelMidiIn);
+
+					int priority = 0;
+					RtMidiIn::ThreadPolicy policy = mMidiIn->getThreadPolicy(&priority);
+					mInputRealtime = (policy == RtMidiIn::THREAD_REALTIME);
+
+					switch (policy) {
+					case RtMidiIn::THREAD_REALTIME:
+						TwisterLog(TWISTER_LOG_NOTICE) << "Twister midi input thread: realtime, priority " << priority;
+						break;
+					case RtMidiIn::THREAD_NORMAL:
+						TwisterLog(TWISTER_LOG_NOTICE) << "Twister midi input thread: default scheduling";
+						break;
+					default:
+						TwisterLog(TWISTER_LOG_NOTICE) << "Twister midi input thread: scheduled by the midi driver";
+						break;
+					}
+
+					// ignore timing and active sensing, but not sysex, 
+					// which carries replies to config read-back.
+					mMidiIn->ignoreTypes(false, true, true);
+
+					// the twister only sends controller messages and 
+					// sysex that we care about; where the midi api 
+					// supports it, anything else is dropped before it 
+					// reaches us.
+					mMidiIn->setEventTypeFilter(RtMidiIn::EVENT_CONTROLLER | RtMidiIn::EVENT_SYSEX);
+				}
+			}
+		}
+	}
+	catch (RtMidiError &error)
+	{
+		std::cout << "MIDI input exception:" << std::endl;
+		error.printMessage();
+	}
+
+	reconnect = false;
+	if (mMidiOut != nullptr) {
+		reconnect = mMidiOut->isPortOpen();
+		mMidiOut->closePort();
+		delete mMidiOut;
+		mMidiOut = nullptr;
+	}
+
+	// establish midi out connection
+	try {
+		mMidiOut = new RtMidiOut(api_);
+		size_t numPorts = mMidiOut->getPortCount();
+		size_t midiPort = -1;
+		const std::string deviceName("Midi Fighter Twister");
+		if (mMidiOut->getPortCount() >= 1)
+		{
+			for (size_t i = 0; i < numPorts; ++i)
+			{
+				if (mMidiOut->getPortName(i).substr(0, deviceName.size()) == deviceName)
+				{
+					midiPort = i;
+					if (reconnect)
+						bump(mChannelMidiIn.stats.reconnects);
+					mMidiOut->openPort(midiPort);
+				}
+			}
+		}
+	}
+	catch (RtMidiError &error)
+	{
+		std::cout << "MIDI output exception:" << std::endl;
+		error.printMessage();
+	}
+
+	// assign ids to encoders
+	for (int i = 0; i < 16; ++i) {
+		mEncoders[i].pos = i;
+		mEncoders[i].mMidiOut = mMidiOut;
+		mEncoders[i].mShared = &mChannelMidiIn;
+	};
+}
+
+// ------------------------------------------------------
+
+
+// ------------------------------------------------------
+
+void TwisterCore::setParams(std::vector<TwisterParam> params_)
+{
+	TwisterLog(TWISTER_LOG_VERBOSE) << "Updating mapping";
+	/*
+
+	based on incoming parameters,
+	we set our Encoders to track them
+
+	*/
+
+	// a running morph refers to the old parameters.
+	mMorph.active = false;
+
+	mParams = std::move(params_);
+
+	mPage = 0;
+	bindPage();
+}
+
+// ------------------------------------------------------
+
+const std::vector<TwisterParam>& TwisterCore::getParams() const {
+	return mParams;
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::bindPage() {
+
+	const size_t offset = mPage * mEncoders.size();
+
+	for (size_t i = 0; i < mEncoders.size(); ++i) {
+		const size_t idx = offset + i;
+		bindEncoder(mEncoders[i], idx < mParams.size() ? &mParams[idx] : nullptr);
+	}
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::bindPath(const std::string& path_) {
+
+	const size_t offset = mPage * mEncoders.size();
+
+	for (size_t i = 0; i < mEncoders.size() && offset + i < mParams.size(); ++i) {
+		if (mParams[offset + i].path == path_) {
+			bindEncoder(mEncoders[i], &mParams[offset + i]);
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::bindEncoder(Encoder& e, const TwisterParam* p_) {
+
+	if (p_ == nullptr) {
+		// no more parameters to map.
+		e.updateParameter = nullptr;
+		e.mParamListener = nullptr; // reset listener
+		e.setState(Encoder::State::DISABLED, true);
+		return;
+	}
+
+	// ----------| invariant: p_ is a valid leaf parameter
+
+	switch (p_->type)
+	{
+	case TwisterParam::Type::FLOAT:
+	{
+		// bingo, we have a float param
+		auto set = p_->set;
+
+		auto opts = mBindingOptions.find(p_->path);
+		e.curve  = (opts != mBindingOptions.end()) ? opts->second.curve : ResponseCurve();
+		e.pickup = (opts != mBindingOptions.end()) ? opts->second.pickup : false;
+
+		auto pMin = p_->min;
+		auto pMax = p_->max;
+
+		e.setState(Encoder::State::ROTARY);
+		e.setValue(e.curve.toMidi(mapClamped(p_->get(), pMin, pMax, 0.f, 1.f)));
+
+		// the parameter may have changed while it was not bound,
+		// so we must wait for the knob to pick it up again.
+		e.armPickup();
+
+		// now set the Encoder's event listener to track 
+		// this parameter
+
+		e.updateParameter = [&e, set, pMin, pMax](uint8_t v_) {
+			// on midi input
+			set(pMin + (pMax - pMin) * e.curve.toNormalised(v_));
+		};
+
+		e.mParamListener = !p_->listen ? nullptr : p_->listen([&e, pMin, pMax](float v_) {
+			// on parameter change, write from parameter 
+			// to midi.
+			e.setValue(e.curve.toMidi(mapClamped(v_, pMin, pMax, 0.f, 1.f)));
+		});
+	}
+		break;
+	case TwisterParam::Type::BOOL:
+	{
+		// we have a bool parameter
+		auto set = p_->set;
+
+		e.pickup = false;
+		e.pickedUp = true;
+		e.setState(Encoder::State::SWITCH);
+		e.setValue((p_->get() >= 0.5f) ? 127 : 0);
+
+		e.updateParameter = [=](uint8_t v_) {
+			set((v_ > 63) ? 1.f : 0.f);
+		};
+
+		e.mParamListener = !p_->listen ? nullptr : p_->listen([&e](float v_) {
+			e.setValue(v_ >= 0.5f ? 127 : 0);
+		});
+	}
+		break;
+	default:
+		// we cannot match this parameter, unfortunately
+		e.updateParameter = nullptr;
+		e.mParamListener = nullptr; // reset listener
+		e.setState(Encoder::State::DISABLED);
+		break;
+	}
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::setPage(size_t page_) {
+	page_ = std::min(page_, getNumPages() - 1);
+
+	if (page_ == mPage)
+		return;
+
+	// ----------| invariant: page has changed
+
+	mPage = page_;
+	bindPage();
+}
+
+// ------------------------------------------------------
+
+size_t TwisterCore::getPage() const {
+	return mPage;
+}
+
+// ------------------------------------------------------
+
+size_t TwisterCore::getNumPages() const {
+	// there is always at least one page, even if it is empty.
+	return std::max<size_t>(1, (mParams.size() + mEncoders.size() - 1) / mEncoders.size());
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::nextPage() {
+	setPage((mPage + 1) % getNumPages());
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::previousPage() {
+	setPage((mPage + getNumPages() - 1) % getNumPages());
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::setResponseCurve(const std::string& path_, const ResponseCurve& curve_) {
+	mBindingOptions[path_].curve = curve_;
+	bindPath(path_);
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::setPickupMode(const std::string& path_, bool enabled_) {
+	mBindingOptions[path_].pickup = enabled_;
+	bindPath(path_);
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::update() {
+
+	MidiCCBatch batch;
+
+	if (isTracing()) {
+		mChannelMidiIn.trace.setThreadName("main");
+	}
+	TraceRecorder::Span span(mChannelMidiIn.trace, "update");
+	uint32_t received = 0;
+
+	bool recorded = false;
+
+	while (mChannelMidiIn.controller.tryReceive(batch)) {
+		// we got a batch of messages.
+		mChannelMidiIn.stats.queued.fetch_sub(batch.count, std::memory_order_relaxed);
+		received += uint32_t(batch.count);
+
+		if (mRecorder.isOpen()) {
+			recordBatch(batch);
+			recorded = true;
+		}
+
+		processBatch(batch);
+	}
+
+	span.setArg(received);
+
+	// a crash should not cost more than a frame's worth of records.
+	if (recorded) {
+		mRecorder.flush();
+	}
+
+	if (mReplay.active) {
+		updateReplay();
+	}
+
+	updateMorph();
+
+	if (mLatencyDump.intervalMs > 0 && isLatencyTracking()) {
+		const uint64_t now = clock().nowMs();
+		if (now - mLatencyDump.lastMs >= mLatencyDump.intervalMs) {
+			mLatencyDump.lastMs = now;
+			logLatency();
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::processBatch(const MidiCCBatch& batch_) {
+
+	TraceRecorder::Span span(mChannelMidiIn.trace, "dispatch", uint32_t(batch_.count));
+
+	// rotary values are absolute, so only the last one per
+	// encoder in a batch needs to be applied.
+	const uint64_t superseded = supersededRotary(batch_);
+
+	if (batch_.callbackNs != 0) {
+		dispatchTracked(batch_, superseded);
+		return;
+	}
+
+	for (size_t i = 0; i < batch_.count; ++i) {
+		if ((superseded >> i) & 1) {
+			bump(mChannelMidiIn.stats.coalesced);
+			continue;
+		}
+		dispatch(batch_.messages[i]);
+	}
+}
+
+// ------------------------------------------------------
+
+uint64_t TwisterCore::supersededRotary(const MidiCCBatch& batch_) const {
+	static_assert(MidiCCBatch::kCapacity <= 64, "one bit per message");
+
+	uint64_t superseded = 0;
+	uint32_t seen = 0; // encoders which have a later message in this run
+
+	// only runs of rotary messages are coalesced: anything else - a
+	// switch, a page or bank change - may rebind encoders, so that
+	// values either side of it may be meant for different parameters.
+	for (size_t i = batch_.count; i-- > 0;) {
+		const MidiCCMessage& m = batch_.messages[i];
+		if (m.command_channel != 0xB0 || m.controller >= mEncoders.size() ||
+			mEncoders[m.controller].mState != Encoder::State::ROTARY) {
+			seen = 0;
+			continue;
+		}
+
+		// ----------| invariant: rotary message for one of our bound rotary encoders
+
+		// pickup needs to see every value, to tell when the 
+		// knob crosses the parameter.
+		if (mEncoders[m.controller].pickup)
+			continue;
+
+		const uint32_t bit = uint32_t(1) << m.controller;
+		if (seen & bit)
+			superseded |= uint64_t(1) << i;
+		seen |= bit;
+	}
+
+	return superseded;
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::dispatchTracked(const MidiCCBatch& batch_, uint64_t superseded_) {
+	auto& latency = mChannelMidiIn.latency;
+
+	const uint64_t dequeueNs = clock().nowNs();
+	latency[LatencyStage::CALLBACK_TO_DEQUEUE].record(elapsedNs(batch_.callbackNs, dequeueNs), batch_.count);
+
+	for (size_t i = 0; i < batch_.count; ++i) {
+		if ((superseded_ >> i) & 1) {
+			bump(mChannelMidiIn.stats.coalesced);
+			continue;
+		}
+
+		const MidiCCMessage& m = batch_.messages[i];
+		dispatch(m);
+
+		const uint64_t applyNs = clock().nowNs();
+		latency[LatencyStage::DEQUEUE_TO_APPLY].record(elapsedNs(dequeueNs, applyNs));
+		if (m.timeNs != 0) {
+			latency[LatencyStage::END_TO_END].record(elapsedNs(m.timeNs, applyNs));
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::setLatencyTracking(bool enabled_, uint64_t dumpIntervalMs_) {
+	mLatencyDump.intervalMs = dumpIntervalMs_;
+	mLatencyDump.lastMs     = clock().nowMs();
+	mChannelMidiIn.latency.enabled.store(enabled_, std::memory_order_relaxed);
+}
+
+// ------------------------------------------------------
+
+bool TwisterCore::isLatencyTracking() const {
+	return mChannelMidiIn.latency.enabled.load(std::memory_order_relaxed);
+}
+
+// ------------------------------------------------------
+
+const LatencyHistogram& TwisterCore::getLatency(LatencyStage stage_) const {
+	return mChannelMidiIn.latency.stages[size_t(stage_)];
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::resetLatency() {
+	for (auto& h : mChannelMidiIn.latency.stages) {
+		h.reset();
+	}
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::logLatency() const {
+	for (size_t i = 0; i < size_t(LatencyStage::COUNT); ++i) {
+		TwisterLog(TWISTER_LOG_NOTICE, "ofxParameterTwister") << "latency " << kLatencyStageNames[i] << ": " << mChannelMidiIn.latency.stages[i].summary();
+	}
+}
+
+// ------------------------------------------------------
+
+bool TwisterCore::startRecording(const std::string& path_) {
+	if (!mRecorder.open(path_, clock().nowNs())) {
+		TwisterLog(TWISTER_LOG_ERROR) << "Twister session: could not record to " << path_;
+		return false;
+	}
+	return true;
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::stopRecording() {
+	mRecorder.close();
+}
+
+// ------------------------------------------------------
+
+bool TwisterCore::isRecording() const {
+	return mRecorder.isOpen();
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::recordBatch(const MidiCCBatch& batch_) {
+	std::array<MidiSessionRecord, MidiCCBatch::kCapacity> records;
+	uint64_t now = 0;
+
+	for (size_t i = 0; i < batch_.count; ++i) {
+		const MidiCCMessage& m = batch_.messages[i];
+		MidiSessionRecord& r = records[i];
+		r = MidiSessionRecord();
+
+		if (m.timeNs == 0 && now == 0) {
+			now = clock().nowNs();
+		}
+		r.timeNs          = m.timeNs != 0 ? m.timeNs : now;
+		r.command_channel = m.command_channel;
+		r.controller      = m.controller;
+		r.value           = m.value;
+	}
+
+	mRecorder.append(records.data(), batch_.count);
+}
+
+// ------------------------------------------------------
+
+bool TwisterCore::startReplay(const std::string& path_, bool realtime_) {
+	Replay replay;
+	std::string error;
+	if (!readMidiSession(path_, replay.records, &error)) {
+		TwisterLog(TWISTER_LOG_ERROR) << "Twister session: " << error;
+		return false;
+	}
+
+	replay.id       = ++mReplayCount;
+	replay.active   = true;
+	replay.realtime = realtime_;
+	replay.lastNs   = clock().nowNs();
+
+	mReplay = std::move(replay);
+	return true;
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::stopReplay() {
+	mReplay = Replay();
+}
+
+// ------------------------------------------------------
+
+bool TwisterCore::isReplaying() const {
+	return mReplay.active;
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::updateReplay() {
+
+	// replayed messages keep their relative timing, as if the
+	// session had started when the replay did. recordings appended
+	// to the session follow on, each on a timeline of its own.
+	const uint64_t now = clock().nowNs();
+	const uint64_t id  = mReplay.id;
+	MidiCCBatch batch;
+
+	for (; mReplay.next < mReplay.records.size(); ++mReplay.next) {
+		const MidiSessionRecord& r = mReplay.records[mReplay.next];
+		if (r.command_channel == 0)
+			continue; // padding
+
+		if (r.command_channel == MidiSessionRecord::kSessionStart) {
+			mReplay.anchored = false;
+			continue;
+		}
+
+		if (!mReplay.anchored) {
+			// a recording's first message plays right after
+			// the previous recording's last.
+			mReplay.startNs  = mReplay.lastNs;
+			mReplay.firstNs  = r.timeNs;
+			mReplay.anchored = true;
+		}
+
+		const uint64_t timeNs = mReplay.startNs + elapsedNs(mReplay.firstNs, r.timeNs);
+		if (mReplay.realtime && timeNs > now)
+			break;
+
+		// ----------| invariant: this record is due
+
+		mReplay.lastNs = timeNs;
+
+		// a session file may be damaged: decode records
+		// as strictly as live input.
+		const uint8_t bytes[3] = { r.command_channel, r.controller, r.value };
+		MidiCCMessage& m = batch.messages[batch.count];
+		if (!m.decode(bytes, sizeof(bytes))) {
+			bump(mChannelMidiIn.stats.ignored);
+			continue;
+		}
+
+		++batch.count;
+		m.timeNs = timeNs;
+
+		if (batch.count == MidiCCBatch::kCapacity) {
+			processBatch(batch);
+			batch.count = 0;
+
+			// an action may have stopped the replay, or started
+			// another one, which must not skip its first record.
+			if (mReplay.id != id)
+				return;
+		}
+	}
+
+	if (mReplay.next == mReplay.records.size()) {
+		stopReplay();
+	}
+
+	if (batch.count > 0) {
+		processBatch(batch);
+	}
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::injectInput(const RtMidiMessage* messages_, unsigned int count_) {
+	onMidiInput(messages_, count_, &mChannelMidiIn);
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::setTracing(bool enabled_) {
+	mChannelMidiIn.trace.setEnabled(enabled_);
+}
+
+// ------------------------------------------------------
+
+bool TwisterCore::isTracing() const {
+	return mChannelMidiIn.trace.isEnabled();
+}
+
+// ------------------------------------------------------
+
+bool TwisterCore::writeTrace(const std::string& path_) const {
+	if (!mChannelMidiIn.trace.writeChromeTrace(path_)) {
+		TwisterLog(TWISTER_LOG_ERROR) << "Twister trace: could not write " << path_;
+		return false;
+	}
+	return true;
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::clearTrace() {
+	mChannelMidiIn.trace.clear();
+}
+
+// ------------------------------------------------------
+
+TwisterStats::Snapshot TwisterCore::getStats() const {
+	return mChannelMidiIn.stats.snapshot();
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::resetStats() {
+	mChannelMidiIn.stats.reset();
+}
+
+// ------------------------------------------------------
+
+TwisterStats::Snapshot TwisterStats::load() const {
+	Snapshot s;
+	for (size_t i = 0; i < received.size(); ++i) {
+		s.received[i] = received[i].load(std::memory_order_relaxed);
+	}
+	s.rejected       = rejected.load(std::memory_order_relaxed);
+	s.dropped        = dropped.load(std::memory_order_relaxed);
+	s.dispatched     = dispatched.load(std::memory_order_relaxed);
+	s.coalesced      = coalesced.load(std::memory_order_relaxed);
+	s.ignored        = ignored.load(std::memory_order_relaxed);
+	s.outOfRange     = outOfRange.load(std::memory_order_relaxed);
+	s.sent           = sent.load(std::memory_order_relaxed);
+	s.bytesOut       = bytesOut.load(std::memory_order_relaxed);
+	s.sendErrors     = sendErrors.load(std::memory_order_relaxed);
+	s.reconnects     = reconnects.load(std::memory_order_relaxed);
+	s.queued         = queued.load(std::memory_order_relaxed);
+	s.queueHighWater = queueHighWater.load(std::memory_order_relaxed);
+	return s;
+}
+
+// ------------------------------------------------------
+
+TwisterStats::Snapshot TwisterStats::snapshot() const {
+	std::lock_guard<std::mutex> lock(mBaselineMutex);
+
+	// counters only ever grow, so they can't be behind their baseline.
+	Snapshot s = load();
+	for (size_t i = 0; i < s.received.size(); ++i) {
+		s.received[i] -= mBaseline.received[i];
+	}
+	s.rejected   -= mBaseline.rejected;
+	s.dropped    -= mBaseline.dropped;
+	s.dispatched -= mBaseline.dispatched;
+	s.coalesced  -= mBaseline.coalesced;
+	s.ignored    -= mBaseline.ignored;
+	s.outOfRange -= mBaseline.outOfRange;
+	s.sent       -= mBaseline.sent;
+	s.bytesOut   -= mBaseline.bytesOut;
+	s.sendErrors -= mBaseline.sendErrors;
+	s.reconnects -= mBaseline.reconnects;
+	return s;
+}
+
+// ------------------------------------------------------
+
+void TwisterStats::reset() {
+	std::lock_guard<std::mutex> lock(mBaselineMutex);
+	mBaseline = load();
+
+	// queued is a level, not a count, so it stays. the high-water
+	// mark restarts from the current level; should the midi thread
+	// raise it meanwhile, it raises it to a level that was reached.
+	queueHighWater.store(queued.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+// ------------------------------------------------------
+
+const std::array<TwisterCore::ChannelHandler, 16> TwisterCore::sChannelHandlers{ {
+	&TwisterCore::onRotary,      // 0: encoder rotation
+	&TwisterCore::onSwitch,      // 1: encoder switch
+	nullptr,                             // 2: animation - output only
+	&TwisterCore::onSystem,      // 3: side buttons, bank changes
+	&TwisterCore::onShiftRotary, // 4: shifted encoder rotation
+	nullptr,                             // 5: ring animation - output only
+	// channels 6..15 are not used by the twister
+} };
+
+// ------------------------------------------------------
+
+void TwisterCore::dispatch(const MidiCCMessage& m_) {
+
+	auto& stats = mChannelMidiIn.stats;
+
+	// let's get the address.
+	if (m_.getCommand() != 0xB) {
+		bump(stats.ignored);
+		return;
+	}
+
+	// ----------| invariant: this is a CC message
+
+	auto handler = sChannelHandlers[m_.getChannel()];
+	if (handler == nullptr) {
+		bump(stats.ignored);
+		return;
+	}
+
+	bump(stats.dispatched);
+	(this->*handler)(m_);
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::onRotary(const MidiCCMessage& m_) {
+	// the twister sends controllers 0..63, for all four banks,
+	// we only track the first bank.
+	if (m_.controller >= mEncoders.size()) {
+		bump(mChannelMidiIn.stats.outOfRange);
+		return;
+	}
+
+	auto &e = mEncoders[m_.controller];
+	if (e.mState == Encoder::State::ROTARY && e.updateParameter && e.acceptInput(m_.value)) {
+		// spans the parameter's listeners, too.
+		TraceRecorder::Span span(mChannelMidiIn.trace, "parameter set", e.pos);
+		e.updateParameter(m_.value);
+	} else
+		bump(mChannelMidiIn.stats.ignored);
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::onSwitch(const MidiCCMessage& m_) {
+	if (m_.controller >= kEncodersPerDevice) {
+		bump(mChannelMidiIn.stats.outOfRange);
+		return;
+	}
+
+	if (m_.controller < mEncoders.size()) {
+		auto &e = mEncoders[m_.controller];
+		if (e.mState == Encoder::State::SWITCH && e.updateParameter) {
+			TraceRecorder::Span span(mChannelMidiIn.trace, "parameter set", e.pos);
+			e.updateParameter(m_.value);
+		}
+	}
+
+	notifyEvent(m_.value > 63 ? TwisterEvent::Type::ENCODER_PRESS : TwisterEvent::Type::ENCODER_RELEASE, m_.controller, m_);
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::onSystem(const MidiCCMessage& m_) {
+	// controllers 0..3 select banks, 
+	// controllers 8..31 are side buttons, six per bank.
+	if (m_.controller < 4) {
+		if (m_.value > 63)
+			notifyEvent(TwisterEvent::Type::BANK_CHANGE, m_.controller, m_);
+	} else if (m_.controller >= 8 && m_.controller < 32) {
+		notifyEvent(m_.value > 63 ? TwisterEvent::Type::SIDE_BUTTON_PRESS : TwisterEvent::Type::SIDE_BUTTON_RELEASE, m_.controller - 8, m_);
+	} else {
+		bump(mChannelMidiIn.stats.outOfRange);
+	}
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::onShiftRotary(const MidiCCMessage& m_) {
+	if (m_.controller >= kEncodersPerDevice) {
+		bump(mChannelMidiIn.stats.outOfRange);
+		return;
+	}
+	notifyEvent(TwisterEvent::Type::SHIFT_ROTATE, m_.controller, m_);
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::notifyEvent(TwisterEvent::Type type_, uint8_t id_, const MidiCCMessage& m_) {
+	TwisterEvent ev;
+	ev.type = type_;
+	ev.id = id_;
+	ev.value = m_.value;
+	ev.timeNs = m_.timeNs;
+
+	if (mEventHandler)
+		mEventHandler(ev);
+
+	auto it = mActions.find({ type_, id_ });
+	if (it != mActions.end() && it->second)
+		it->second();
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::setEventHandler(std::function<void(const TwisterEvent&)> handler_) {
+	mEventHandler = handler_;
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::bindAction(TwisterEvent::Type type_, uint8_t id_, std::function<void()> action_) {
+	mActions[{ type_, id_ }] = action_;
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::clearActions() {
+	mActions.clear();
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::scheduleMessage(const MidiCCMessage& m_, double delaySeconds_) {
+	if (mMidiOut == nullptr) {
+		return;
+	}
+
+	const unsigned char msg[3] = {
+		m_.command_channel,
+		m_.controller,
+		m_.value,
+	};
+
+	sendCounted(mMidiOut, msg, sizeof(msg), mChannelMidiIn, std::max(0.0, delaySeconds_));
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::cancelScheduledMessages() {
+	if (mMidiOut == nullptr) {
+		return;
+	}
+
+	try {
+		mMidiOut->cancelScheduledMessages();
+	}
+	catch (RtMidiError& error) {
+		error.printMessage();
+	}
+}
+
+// ------------------------------------------------------
+
+bool TwisterCore::uploadConfig(const std::string& mfsPath_, bool force_) {
+	TwisterConfig config;
+	std::string error;
+	if (!config.load(mfsPath_, &error)) {
+		TwisterLog(TWISTER_LOG_ERROR) << "Twister config: " << error;
+		return false;
+	}
+	return uploadConfig(config, force_);
+}
+
+// ------------------------------------------------------
+
+bool TwisterCore::uploadConfig(const TwisterConfig& config_, bool force_) {
+
+	if (mMidiOut == nullptr || !mMidiOut->isPortOpen() ||
+		mMidiIn == nullptr || !mMidiIn->isPortOpen()) {
+		TwisterLog(TWISTER_LOG_ERROR) << "Twister config: device not connected.";
+		return false;
+	}
+
+	const uint64_t hash = config_.hash();
+	
+	if (!force_ && readConfigHash(mConfigHashPath) == hash) {
+		TwisterLog(TWISTER_LOG_NOTICE) << "Twister config unchanged, not uploading.";
+		return true;
+	}
+
+	// upload, in paced batches.
+	auto messages = config_.toSysex();
+	for (size_t i = 0; i < messages.size(); ++i) {
+		sendCounted(mMidiOut, messages[i].data(), messages[i].size(), mChannelMidiIn);
+		if ((i + 1) % kSysexBatchSize == 0) {
+			clock().sleepMs(kSysexBatchPauseMs);
+		}
+	}
+	clock().sleepMs(kSysexBatchPauseMs);
+
+	TwisterConfig readBack;
+	if (!readBackConfig(config_, readBack)) {
+		TwisterLog(TWISTER_LOG_ERROR) << "Twister config: read-back does not match what was uploaded.";
+		return false;
+	}
+
+	writeConfigHash(mConfigHashPath, hash);
+	TwisterLog(TWISTER_LOG_NOTICE) << "Twister config uploaded and verified.";
+	return true;
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::setConfigHashPath(const std::string& path_) {
+	mConfigHashPath = path_;
+}
+
+// ------------------------------------------------------
+
+bool TwisterCore::readBackConfig(const TwisterConfig& config_, TwisterConfig& readBack_) {
+
+	// ----------| invariant: midi in and out are open
+
+	std::vector<uint8_t> reply;
+	while (mChannelMidiIn.sysex.tryReceive(reply)) {
+		// drop anything stale
+	}
+	mChannelMidiIn.sysexWanted = true;
+
+	// requests are pipelined: all of them go out, paced like 
+	// the upload, and replies are collected as they arrive.
+	std::vector<std::vector<uint8_t>> requests{ TwisterConfig::pullGlobalsRequest() };
+	for (const auto& e : config_.encoders) {
+		requests.push_back(TwisterConfig::pullEncoderRequest(e.slot));
+	}
+	for (size_t i = 0; i < requests.size(); ++i) {
+		sendCounted(mMidiOut, requests[i].data(), requests[i].size(), mChannelMidiIn);
+		if ((i + 1) % kSysexBatchSize == 0) {
+			clock().sleepMs(kSysexBatchPauseMs);
+		}
+		while (mChannelMidiIn.sysex.tryReceive(reply)) {
+			readBack_.applySysexReply(reply);
+		}
+	}
+
+	// wait for replies on our clock, so that on a virtual clock,
+	// the timeout takes no real time.
+	const uint64_t deadline = clock().nowMs() + kReadBackTimeoutMs;
+	bool complete = config_.matches(readBack_);
+	while (!complete && clock().nowMs() < deadline) {
+		if (mChannelMidiIn.sysex.tryReceive(reply)) {
+			readBack_.applySysexReply(reply);
+			complete = config_.matches(readBack_);
+		} else {
+			clock().sleepMs(kReadBackPollMs);
+		}
+	}
+
+	mChannelMidiIn.sysexWanted = false;
+	return complete;
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::storePreset(const std::string& name_) {
+
+	Preset preset;
+	preset.path.reserve(mParams.size());
+	preset.value.reserve(mParams.size());
+
+	for (auto & p : mParams) {
+		if (p.type == TwisterParam::Type::UNSUPPORTED)
+			continue;
+		preset.path.push_back(p.path);
+		preset.value.push_back(p.get());
+	}
+
+	mPresets[name_] = std::move(preset);
+}
+
+// ------------------------------------------------------
+
+bool TwisterCore::recallPreset(const std::string& name_, uint64_t morphMillis_) {
+
+	auto it = mPresets.find(name_);
+	if (it == mPresets.end()) {
+		TwisterLog(TWISTER_LOG_WARNING) << "Cannot recall preset '" << name_ << "': no such preset.";
+		return false;
+	}
+
+	// ----------| invariant: preset exists
+
+	const Preset& preset = it->second;
+
+	// resolve preset paths against the current parameters once,
+	// so that the per-frame morph only touches flat arrays.
+	std::map<std::string, uint32_t> indexByPath;
+	for (uint32_t i = 0; i < mParams.size(); ++i) {
+		indexByPath[mParams[i].path] = i;
+	}
+
+	mMorph.index.clear();
+	mMorph.from.clear();
+	mMorph.to.clear();
+
+	for (size_t i = 0; i < preset.path.size(); ++i) {
+		auto idx = indexByPath.find(preset.path[i]);
+		if (idx == indexByPath.end())
+			continue;
+
+		const TwisterParam& p = mParams[idx->second];
+		if (p.type == TwisterParam::Type::UNSUPPORTED)
+			continue;
+
+		mMorph.index.push_back(idx->second);
+		mMorph.from.push_back(p.get());
+		mMorph.to.push_back(preset.value[i]);
+	}
+
+	mMorph.current.resize(mMorph.index.size());
+	mMorph.startMs = clock().nowMs();
+	mMorph.durationMs = morphMillis_;
+	mMorph.active = true;
+
+	// a morph of zero length applies immediately
+	updateMorph();
+
+	return true;
+}
+
+// ------------------------------------------------------
+
+bool TwisterCore::isMorphing() const {
+	return mMorph.active;
+}
+
+// ------------------------------------------------------
+
+void TwisterCore::updateMorph() {
+	if (!mMorph.active)
+		return;
+
+	// ----------| invariant: morph is active
+
+	const uint64_t elapsed = clock().nowMs() - mMorph.startMs;
+	const float t = (mMorph.durationMs == 0 || elapsed >= mMorph.durationMs) ? 1.f : float(elapsed) / float(mMorph.durationMs);
+
+	const size_t n = mMorph.index.size();
+	const float* from = mMorph.from.data();
+	const float* to = mMorph.to.data();
+	float* current = mMorph.current.data();
+
+	// plain loop over flat arrays, so that the compiler may vectorise.
+	for (size_t i = 0; i < n; ++i) {
+		current[i] = from[i] + (to[i] - from[i]) * t;
+	}
+
+	// collect midi output caused by parameter listeners, 
+	// and send it once, after all parameters have been applied.
+	for (auto & e : mEncoders) {
+		e.deferOutput = true;
+	}
+
+	for (size_t i = 0; i < n; ++i) {
+		const TwisterParam& p = mParams[mMorph.index[i]];
+		// bool parameters snap halfway.
+		const float v = (p.type == TwisterParam::Type::BOOL) ? (current[i] >= 0.5f ? 1.f : 0.f) : current[i];
+		if (p.get() != v)
+			p.set(v);
+	}
+
+	for (auto & e : mEncoders) {
+		e.deferOutput = false;
+		e.flush();
+	}
+
+	if (t >= 1.f) {
+		mMorph.active = false;
+	}
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::TwisterCore::Encoder::setState(State s_, bool force_)
+{
+	if (s_ == mState && force_ == false) {
+		return;
+	}
+
+	// ----------| invariant: state change requested, or forced
+
+	switch (s_)
+	{
+	case pal::Kontrol::TwisterCore::Encoder::State::DISABLED:
+		setEncoderAnimation(0);
+		// we need to switch off the status LED
+		sendToSwitch(0);
+		// we need to switch off the rotary status LED
+		sendToRotary(0);
+		setBrightnessRotary(0.f);
+		setBrightnessRGB(1.f);
+		break;
+	case pal::Kontrol::TwisterCore::Encoder::State::ROTARY:
+		sendToSwitch(0);
+		setBrightnessRotary(1.f);
+		setBrightnessRGB(0.0f);
+		break;
+	case pal::Kontrol::TwisterCore::Encoder::State::SWITCH:
+		sendToRotary(0);
+		setBrightnessRotary(0.f);
+		setBrightnessRGB(1.0f);
+		setEncoderAnimation(65);
+		break;
+	default:
+		break;
+	}
+
+	mState = s_;
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::TwisterCore::Encoder::setValue(uint8_t v_) {
+
+	value = v_;
+
+	if (deferOutput) {
+		dirty = true;
+		return;
+	}
+
+	// ----------| invariant: output is not deferred
+
+	switch (mState)
+	{
+	case pal::Kontrol::TwisterCore::Encoder::State::DISABLED:
+		TwisterLog(TWISTER_LOG_ERROR) << "cannot send value to diabled encoder" << pos;
+		break;
+	case pal::Kontrol::TwisterCore::Encoder::State::ROTARY:
+		sendToRotary(v_);
+		break;
+	case pal::Kontrol::TwisterCore::Encoder::State::SWITCH:
+		sendToSwitch(v_);
+		break;
+	default:
+		break;
+	}
+
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::TwisterCore::Encoder::flush() {
+	if (!dirty)
+		return;
+
+	// ----------| invariant: there is a deferred value to send
+
+	dirty = false;
+	setValue(value);
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::TwisterCore::Encoder::armPickup() {
+	pickedUp  = !pickup;
+	lastInput = -1;
+	gapStep   = 0;
+
+	if (pickedUp)
+		return;
+
+	// ----------| invariant: we are waiting for pickup
+
+	// dim the ring, so that it is obvious that the knob 
+	// does not control the parameter yet.
+	setBrightnessRotary(0.3f);
+}
+
+// ------------------------------------------------------
+
+bool pal::Kontrol::TwisterCore::Encoder::acceptInput(uint8_t v_) {
+	if (pickedUp)
+		return true;
+
+	// ----------| invariant: we are waiting for the knob to cross the parameter value
+
+	// value tracks the parameter, since the parameter listener
+	// stays connected while we wait.
+	const int target = value;
+	const int v = v_;
+
+	bool crossed = std::abs(v - target) <= 1;
+	if (lastInput >= 0) {
+		crossed |= (lastInput <= target && v >= target);
+		crossed |= (lastInput >= target && v <= target);
+	}
+
+	if (crossed) {
+		pickedUp = true;
+		setBrightnessRotary(1.f);
+		setBrightnessRGB(0.f);
+		return true;
+	}
+
+	// ----------| invariant: knob has not reached the parameter yet
+
+	lastInput = v;
+
+	// show the size of the gap using RGB brightness - but only 
+	// send if the visible step has changed.
+	uint8_t step = uint8_t(std::abs(v - target) * 30 / 127);
+	if (step != gapStep) {
+		gapStep = step;
+		setBrightnessRGB(step / 30.f);
+	}
+
+	return false;
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::TwisterCore::Encoder::send(uint8_t status_, uint8_t v_) {
+	const unsigned char msg[3] = {
+		status_,
+		pos,					// device id
+		v_,						// value
+	};
+
+	sendCounted(mMidiOut, msg, sizeof(msg), *mShared);
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::TwisterCore::Encoder::sendToSwitch(uint8_t v_) {
+	if (mMidiOut == nullptr)
+		return;
+
+	// ----------| invariant: midiOut is not nullptr
+
+	send(0xB1, v_); // SWITCH listens on channel 1
+
+	TwisterLog(TWISTER_LOG_VERBOSE) << ">>" << std::setw(2) << 1 * pos << " SWI " << " : " << std::setw(3) << v_ * 1;
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::TwisterCore::Encoder::sendToRotary(uint8_t v_) {
+	if (mMidiOut == nullptr)
+		return;
+
+	// ----------| invariant: midiOut is not nullptr
+
+	send(0xB0, v_); // ROTARY listens on channel 0
+
+	TwisterLog(TWISTER_LOG_VERBOSE) << ">>" << std::setw(2) << 1 * pos << " ROT " << " : " << std::setw(3) << v_ * 1;
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::TwisterCore::Encoder::setBrightnessRotary(float b_)
+{
+	if (mMidiOut == nullptr)
+		return;
+
+	// ----------| invariant: midiOut is not nullptr
+
+	unsigned char val = std::roundf(mapClamped(b_, 0.f, 1.f, 65, 95));
+	
+	send(0xB2, val); // animation control channel 2
+
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::TwisterCore::Encoder::setBrightnessRGB(float b_)
+{
+	if (mMidiOut == nullptr)
+		return;
+
+	// ----------| invariant: midiOut is not nullptr
+
+	unsigned char val = std::roundf(mapClamped(b_, 0.f, 1.f, 17, 47));
+
+	send(0xB2, val); // animation control channel 2
+
+}
+// ------------------------------------------------------
+
+// ------------------------------------------------------
+
+void pal::Kontrol::TwisterCore::Encoder::setEncoderAnimation(uint8_t v_)
+{
+	if (mMidiOut == nullptr)
+		return;
+
+	// ----------| invariant: midiOut is not nullptr
+
+	send(0xB2, v_); // animation control channel 2
+
+}
+
+// ------------------------------------------------------
+
+TwisterValue::TwisterValue(float value_)
+	: mValue(value_) {
+}
+
+// ------------------------------------------------------
+
+void TwisterValue::set(float v_) {
+	mValue = v_;
+
+	// listeners whose handle was released drop out here.
+	size_t n = 0;
+	for (size_t i = 0; i < mListeners.size(); ++i) {
+		if (auto listener = mListeners[i].lock()) {
+			(*listener)(v_);
+			mListeners[n++] = mListeners[i];
+		}
+	}
+	mListeners.resize(n);
+}
+
+// ------------------------------------------------------
+
+TwisterParam TwisterValue::param(const std::string& path_, float min_, float max_, TwisterParam::Type type_) {
+	TwisterParam p;
+	p.type = type_;
+	p.path = path_;
+	p.min  = min_;
+	p.max  = max_;
+	p.get  = [this]() { return mValue; };
+	p.set  = [this](float v_) { set(v_); };
+	p.listen = [this](std::function<void(float)> onChange_) {
+		auto listener = std::make_shared<std::function<void(float)>>(std::move(onChange_));
+		mListeners.push_back(listener);
+		return std::shared_ptr<void>(listener);
+	};
+	return p;
+}
@@ -0,0 +1,553 @@
+#pragma once
+
+#include <memory>
+#include <array>
+#include <map>
+#include <functional>
+#include "ThreadChannel.h"
+#include "RtMidi.h"
+#include "ResponseCurve.h"
+#include "TwisterConfig.h"
+#include "LatencyHistogram.h"
+#include "MidiSession.h"
+#include "TraceRecorder.h"
+#include "TwisterLog.h"
+#include "Clock.h"
+#include <atomic>
+#include <mutex>
+
+/*
+
+The Twister engine, without openFrameworks: device i/o, encoder state,
+parameter bindings, dispatch of midi input, presets, and the
+monitoring that comes with it - stats, latency, session recording and
+replay, and tracing.
+
+The core binds TwisterParams - a parameter seen through callbacks -
+so that it can drive anything that has a value and a range.
+TwisterValue is the simplest such thing; ofxParameterTwister binds
+ofParameters, and passes twister events on to an ofEvent.
+
+Paths (sessions, traces, configs) are used as given, relative to the
+working directory.
+
+*/
+#include <cstdint> ///< we include this to get access to standard sized types
+
+namespace pal {
+namespace Kontrol {
+
+struct MidiCCMessage {
+	uint8_t command_channel = 0xB0;
+	uint8_t controller = 0x00;
+	uint8_t value = 0x00;
+	uint64_t timeNs = 0; ///< arrival time, nanoseconds on the core's clock (see Clock); 0 if unknown
+
+	int getCommand() const {
+		// command is in the most significant
+		// 4 bits, so we shift 4 bits to the right.
+		// e.g. 0xB0
+		return command_channel >> 4;
+	};
+
+	int getChannel() const {
+		// channel is the least significant 4 bits,
+		// so we null out the high bits
+		return command_channel & 0x0F;
+	};
+
+	// decode a controller message: exactly three bytes, a control
+	// change status byte (0xB0..0xBF), and two 7 bit data bytes.
+	// anything else - other messages, running status, truncated or
+	// garbled bytes - returns false, and leaves the message alone.
+	bool decode(const uint8_t* bytes_, size_t size_) {
+		if (size_ != 3 || (bytes_[0] & 0xF0) != 0xB0 || ((bytes_[1] | bytes_[2]) & 0x80))
+			return false;
+		command_channel = bytes_[0];
+		controller      = bytes_[1];
+		value           = bytes_[2];
+		return true;
+	};
+
+};
+
+// messages read by the midi thread in one go, passed to
+// update() as a whole, so that we pay for one channel
+// send per wakeup rather than one per message.
+struct MidiCCBatch {
+	static const size_t kCapacity = 64;
+	std::array<MidiCCMessage, kCapacity> messages;
+	size_t count = 0;
+	uint64_t callbackNs = 0; ///< time the callback was entered, if latency is tracked
+};
+
+// stages of input latency, from the time the midi api stamped
+// a message, until update() has applied it.
+enum class LatencyStage {
+	DRIVER_TO_CALLBACK,  ///< midi api timestamp -> midi callback entered
+	CALLBACK_TO_DEQUEUE, ///< midi callback entered -> batch received in update()
+	DEQUEUE_TO_APPLY,    ///< batch received -> message dispatched, parameter set
+	END_TO_END,          ///< midi api timestamp -> message dispatched, parameter set
+	COUNT,
+};
+
+// input latency histograms, recorded from the midi thread
+// and the main thread while tracking is enabled.
+struct InputLatency {
+	std::atomic<bool> enabled{ false };
+	std::array<LatencyHistogram, size_t(LatencyStage::COUNT)> stages;
+
+	LatencyHistogram& operator[](LatencyStage s_) {
+		return stages[size_t(s_)];
+	}
+};
+
+// counters for monitoring the midi pipeline, as relaxed atomics,
+// so that they can be sampled from any thread, every frame - see
+// TwisterCore::getStats(). each counter has a single
+// writing thread, except for queued. 
+//
+// reset() leaves the counters to their writers: it takes a 
+// baseline, which snapshot() subtracts, so that no increment 
+// is lost to a reset.
+struct TwisterStats {
+	std::array<std::atomic<uint64_t>, 16> received{}; ///< controller messages received, per midi channel (midi thread)
+	std::atomic<uint64_t> rejected{ 0 };       ///< input which is not a well-formed controller message, or unwanted sysex (midi thread)
+	std::atomic<uint64_t> dropped{ 0 };        ///< input lost because the queue to update() was full (midi thread)
+
+	std::atomic<uint64_t> dispatched{ 0 };     ///< messages passed to a channel handler in update()
+	std::atomic<uint64_t> coalesced{ 0 };      ///< rotary messages skipped, because a later one in the same run supersedes them
+	std::atomic<uint64_t> ignored{ 0 };        ///< unused channel, unbound encoder, waiting for pickup, or a garbled replay record
+	std::atomic<uint64_t> outOfRange{ 0 };     ///< controller number beyond the encoders or buttons we track
+
+	std::atomic<uint64_t> sent{ 0 };           ///< midi messages sent
+	std::atomic<uint64_t> bytesOut{ 0 };
+	std::atomic<uint64_t> sendErrors{ 0 };     ///< sends which failed, or found the port closed
+	std::atomic<uint64_t> reconnects{ 0 };     ///< ports opened by setup() while a previous connection existed
+
+	std::atomic<uint64_t> queued{ 0 };         ///< messages waiting between midi callback and update()
+	std::atomic<uint64_t> queueHighWater{ 0 }; ///< most messages ever waiting
+
+	// the same counters, as plain values.
+	struct Snapshot {
+		std::array<uint64_t, 16> received{};
+		uint64_t rejected       = 0;
+		uint64_t dropped        = 0;
+		uint64_t dispatched     = 0;
+		uint64_t coalesced      = 0;
+		uint64_t ignored        = 0;
+		uint64_t outOfRange     = 0;
+		uint64_t sent           = 0;
+		uint64_t bytesOut       = 0;
+		uint64_t sendErrors     = 0;
+		uint64_t reconnects     = 0;
+		uint64_t queued         = 0;
+		uint64_t queueHighWater = 0;
+	};
+
+	Snapshot snapshot() const;
+	void reset();
+
+private:
+	Snapshot load() const; ///< the counters as they stand, without baseline
+
+	mutable std::mutex mBaselineMutex;
+	Snapshot           mBaseline;
+};
+
+// everything the midi thread shares with the main thread.
+struct MidiInChannels {
+	// room for 256 batches - a few seconds of input from the device,
+	// should update() stall. input beyond that is dropped.
+	ThreadChannel<MidiCCBatch> controller{ 256 };
+
+	// sysex is only passed on while we are waiting for
+	// replies from the device - anything else is dropped.
+	ThreadChannel<std::vector<uint8_t>> sysex{ 256 };
+	std::atomic<bool> sysexWanted{ false };
+
+	InputLatency latency;
+	TwisterStats stats;
+	TraceRecorder trace;
+
+	std::atomic<Clock*> clock{ &SteadyClock::instance() };
+};
+
+
+
+
+// input from the twister which does not directly map to a parameter.
+// channels are 0-based, as on the wire.
+struct TwisterEvent {
+	enum class Type {
+		ENCODER_PRESS,        ///< encoder switch pressed  (channel 1)
+		ENCODER_RELEASE,      ///< encoder switch released (channel 1)
+		SIDE_BUTTON_PRESS,    ///< side button pressed     (channel 3)
+		SIDE_BUTTON_RELEASE,  ///< side button released    (channel 3)
+		SHIFT_ROTATE,         ///< encoder turned while shift is held (channel 4)
+		BANK_CHANGE,          ///< bank selected           (channel 3)
+	} type = Type::ENCODER_PRESS;
+
+	uint8_t id = 0;     ///< encoder 0..63, side button 0..23, or bank 0..3
+	uint8_t value = 0;  ///< raw midi value
+	uint64_t timeNs = 0; ///< time the midi message arrived, nanoseconds on the core's clock
+};
+
+// a leaf parameter, as the core sees it: a value within a range,
+// read, written and observed through callbacks. bool parameters
+// read and write 0.f or 1.f.
+struct TwisterParam {
+	enum class Type {
+		UNSUPPORTED,
+		FLOAT,
+		BOOL,
+	} type = Type::UNSUPPORTED;
+
+	std::string path; ///< names of enclosing groups and parameter, separated by '/'
+
+	float min = 0.f;
+	float max = 1.f;
+
+	std::function<float()>     get;
+	std::function<void(float)> set;
+
+	// call onChange_ whenever the value changes, until the returned
+	// handle is released. may be empty, if the value only ever
+	// changes through the twister.
+	std::function<std::shared_ptr<void>(std::function<void(float)> onChange_)> listen;
+};
+
+// a value which notifies its listeners whenever it is set - something
+// to bind a TwisterParam to, where there are no other parameters. the
+// value must outlive the param's binding.
+class TwisterValue
+{
+public:
+	explicit TwisterValue(float value_ = 0.f);
+
+	float get() const { return mValue; }
+	void  set(float v_);
+
+	TwisterParam param(const std::string& path_, float min_ = 0.f, float max_ = 1.f, TwisterParam::Type type_ = TwisterParam::Type::FLOAT);
+
+private:
+	float mValue;
+	std::vector<std::weak_ptr<std::function<void(float)>>> mListeners;
+};
+
+class TwisterCore
+{
+
+	struct Encoder {
+
+		RtMidiOut*	mMidiOut = nullptr;
+		MidiInChannels* mShared = nullptr; ///< for counting and tracing sends
+
+		// position on the controller left to right,
+		// top to bottom
+		uint8_t pos = 0;
+
+		// knob may be either
+		// disabled, or a rotary controller, or a switch.
+		enum class State {
+			DISABLED,
+			ROTARY,
+			SWITCH
+		} mState = State::DISABLED;
+
+		// internal representation of the knob value
+		// may be 0..127
+		uint8_t value = 0;
+
+		// maps midi values to normalised parameter values for
+		// rotary encoders.
+		ResponseCurve curve;
+
+		// pickup (soft-takeover): while armed, device input is ignored
+		// until it crosses the parameter's current value.
+		bool    pickup     = false; ///< pickup enabled for this binding
+		bool    pickedUp   = true;  ///< false while waiting for the knob to cross the parameter value
+		int16_t lastInput  = -1;    ///< last ignored device value, -1 if none yet
+		uint8_t gapStep    = 0;     ///< brightness step currently showing the gap
+
+		// listens for parameter change, see TwisterParam::listen
+		std::shared_ptr<void> mParamListener;
+
+		std::function<void(uint8_t v_)> updateParameter;
+
+		// while output is deferred, setValue only records the
+		// value; flush() then sends it, once.
+		bool deferOutput = false;
+		bool dirty       = false;
+
+		void setState(State s_, bool force_ = false);
+		void setValue(uint8_t v_);
+		void flush();
+
+		void armPickup();
+		bool acceptInput(uint8_t v_); ///< false if input must be ignored, because pickup has not happened yet
+
+		void send(uint8_t status_, uint8_t v_);
+		void sendToSwitch(uint8_t v_);
+		void sendToRotary(uint8_t v_);
+
+		void setEncoderAnimation(uint8_t v_);
+		void setBrightnessRotary(float b_); /// brightness is normalised over 31 steps 0..30
+		void setBrightnessRGB(float b_);
+	};
+
+
+public:
+
+	~TwisterCore();
+
+	// request realtime (SCHED_FIFO) scheduling for the midi input
+	// thread, optionally pinned to cpu_. call this before setup().
+	// where realtime scheduling is not permitted, input falls back
+	// to the default policy - see isInputRealtime().
+	void setRealtimeInput(bool enabled_, int priority_ = 80, int cpu_ = -1);
+	bool isInputRealtime() const;
+
+	// the clock all timing goes by - see Clock.h. nullptr selects
+	// SteadyClock, the default. clock_ must outlive the core; set
+	// it before setup(), and before any timing starts. against the
+	// loopback api, input is stamped with this clock, too.
+	void setClock(Clock* clock_);
+
+	// api_ selects the midi backend; RtMidi::LOOPBACK runs against
+	// in-process ports (see RtMidiLoopback) instead of a device.
+	// either way, the ports named "Midi Fighter Twister" are opened.
+	void setup(RtMidi::Api api_ = RtMidi::UNSPECIFIED);
+
+	void update(); // this is where we apply values.
+
+	// parameters are bound in order, and laid out in pages of 16.
+	void setParams(std::vector<TwisterParam> params_);
+	const std::vector<TwisterParam>& getParams() const;
+
+	void   setPage(size_t page_);
+	size_t getPage() const;
+	size_t getNumPages() const;
+	void   nextPage();
+	void   previousPage();
+
+	// set the response curve for the float parameter at path_
+	// (see TwisterParam::path). curves persist across calls to
+	// setParams, and apply whenever a parameter with this path
+	// gets bound to an encoder.
+	void setResponseCurve(const std::string& path_, const ResponseCurve& curve_);
+
+	// enable pickup (soft-takeover) for the float parameter at path_.
+	// once bound, the encoder ignores device input until the knob
+	// crosses the parameter's current value; meanwhile, the
+	// encoder's RGB LED brightness shows the size of the gap.
+	void setPickupMode(const std::string& path_, bool enabled_);
+
+	// presets capture the current values of all float and bool
+	// parameters.
+	void storePreset(const std::string& name_);
+
+	// recall a preset, morphing towards it over morphMillis_.
+	// while morphing, parameters are applied once per update(), and
+	// encoders receive at most one midi message each per update().
+	// returns false if there is no preset with this name.
+	bool recallPreset(const std::string& name_, uint64_t morphMillis_ = 0);
+	bool isMorphing() const;
+
+	// all twister events are passed to handler_, from within update().
+	void setEventHandler(std::function<void(const TwisterEvent&)> handler_);
+
+	// bind an action to a specific event, e.g. a side button press
+	// to nextPage(). actions are called from within update().
+	void bindAction(TwisterEvent::Type type_, uint8_t id_, std::function<void()> action_);
+	void clearActions();
+
+	// send a raw controller message to the twister, delaySeconds_
+	// from now - e.g. to queue up LED animation ahead of time.
+	// where the midi api can't schedule (anything but ALSA), the
+	// message is sent immediately. like any send, it is counted in
+	// stats, failures as sendErrors.
+	void scheduleMessage(const MidiCCMessage& m_, double delaySeconds_);
+	void cancelScheduledMessages();
+
+	// upload a device configuration, as saved by the Midi Fighter
+	// Utility (.mfs, see data/mapping.mfs), so that deployments don't
+	// need the utility. call after setup(); this blocks until the
+	// config has been sent in paced batches of sysex, read back, and
+	// compared. the hash of the last config that verified is cached
+	// (see setConfigHashPath), and an unchanged config is skipped
+	// unless force_ is set. returns false if the config could not be
+	// loaded, or did not verify.
+	//
+	// pacing takes 20 ms per 8 messages, each way - about 350 ms for
+	// a full config - and a device which does not answer is waited 
+	// for up to another second, all on the calling thread. upload at 
+	// startup, or between shows, rather than from a running frame.
+	bool uploadConfig(const std::string& mfsPath_, bool force_ = false);
+	bool uploadConfig(const TwisterConfig& config_, bool force_ = false);
+	void setConfigHashPath(const std::string& path_);
+
+	// track input latency - see LatencyStage - in histograms. when
+	// tracking is off, this costs a flag check per batch of messages.
+	// with dumpIntervalMs_ > 0, update() logs a summary per stage
+	// at that interval.
+	void setLatencyTracking(bool enabled_, uint64_t dumpIntervalMs_ = 0);
+	bool isLatencyTracking() const;
+	const LatencyHistogram& getLatency(LatencyStage stage_) const;
+	void resetLatency();
+	void logLatency() const;
+
+	// pipeline counters - see TwisterStats. sampling loads each
+	// counter once, under a lock only resetStats() contends for, 
+	// so it is cheap enough to do every frame.
+	TwisterStats::Snapshot getStats() const;
+	void resetStats();
+
+	// record controller messages from the twister to a session file
+	// (see MidiSession.h), appending if the file exists. messages
+	// are written as update() receives them, before coalescing.
+	bool startRecording(const std::string& path_);
+	void stopRecording();
+	bool isRecording() const;
+
+	// replay a recorded session through the same dispatch as live
+	// input, from within update() - in real time, or all of it in
+	// the next update(), which makes replay deterministic. live
+	// input keeps working meanwhile, and is not recorded twice.
+	bool startReplay(const std::string& path_, bool realtime_ = true);
+	void stopReplay();
+	bool isReplaying() const;
+
+	// trace midi arrivals and callbacks on the midi input thread, and
+	// update(), dispatch, parameter changes (with their listeners) and
+	// sends on the main thread - see TraceRecorder. writeTrace()
+	// exports Chrome trace JSON, for chrome://tracing or Perfetto.
+	// clearTrace() forgets the events recorded so far; both may be 
+	// called while tracing, and while the midi thread records.
+	void setTracing(bool enabled_);
+	bool isTracing() const;
+	bool writeTrace(const std::string& path_) const;
+	void clearTrace();
+
+	// hand input to the addon as if it came from the device, through
+	// the callback the midi thread uses - for tests and fuzzing.
+	// messages are applied in the next update(). don't call this
+	// while the midi thread may deliver input, too.
+	void injectInput(const RtMidiMessage* messages_, unsigned int count_);
+
+private:
+
+	Clock& clock() const;
+
+	// midi input is dispatched through a table of handlers indexed by
+	// channel, so that handling more channels costs no extra branches.
+	typedef void (TwisterCore::*ChannelHandler)(const MidiCCMessage&);
+	static const std::array<ChannelHandler, 16> sChannelHandlers;
+
+	void processBatch(const MidiCCBatch& batch_); ///< coalesce, and dispatch
+	void dispatch(const MidiCCMessage& m_);
+	void dispatchTracked(const MidiCCBatch& batch_, uint64_t superseded_); ///< dispatch, and record latency
+
+	// bit i is set if message i is a rotary message which a later
+	// message for the same encoder supersedes, with nothing but
+	// rotary messages in between.
+	uint64_t supersededRotary(const MidiCCBatch& batch_) const;
+
+	void onRotary(const MidiCCMessage& m_);
+	void onSwitch(const MidiCCMessage& m_);
+	void onSystem(const MidiCCMessage& m_);
+	void onShiftRotary(const MidiCCMessage& m_);
+
+	void notifyEvent(TwisterEvent::Type type_, uint8_t id_, const MidiCCMessage& m_);
+
+	// a preset, as struct-of-arrays. bool parameters are stored
+	// as 0.f or 1.f, so that the same interpolation applies.
+	struct Preset {
+		std::vector<std::string> path;
+		std::vector<float>       value;
+	};
+
+	// an active morph, resolved against mParams when recalled,
+	// as struct-of-arrays so that interpolation is a tight loop.
+	struct Morph {
+		bool     active     = false;
+		uint64_t startMs    = 0;
+		uint64_t durationMs = 0;
+
+		std::vector<uint32_t> index; ///< into mParams
+		std::vector<float>    from;
+		std::vector<float>    to;
+		std::vector<float>    current;
+	};
+
+	void updateMorph();
+
+	// per-parameter binding options, by parameter path
+	struct BindingOptions {
+		ResponseCurve curve;
+		bool pickup = false;
+	};
+
+	void bindPage();
+	void bindPath(const std::string& path_); ///< re-bind path_'s encoder, if path_ is on the current page
+	void bindEncoder(Encoder& e, const TwisterParam* p_);
+
+	struct RealtimeInput {
+		bool enabled  = false;
+		int  priority = 80;
+		int  cpu      = -1;
+	} mRealtimeInput;
+
+	bool mInputRealtime = false; ///< effective input thread policy, as reported by RtMidi
+
+	RtMidiIn*	mMidiIn = nullptr;
+	RtMidiOut*	mMidiOut = nullptr;
+
+	MidiInChannels mChannelMidiIn;
+
+	void recordBatch(const MidiCCBatch& batch_);
+	void updateReplay();
+
+	MidiSessionWriter mRecorder;
+
+	struct Replay {
+		uint64_t id       = 0;     ///< tells replays apart, 0 if none is active
+		bool     active   = false;
+		bool     realtime = true;
+		size_t   next     = 0;
+		bool     anchored = false; ///< false until the current recording's first record is read
+		uint64_t startNs  = 0;     ///< when the current recording's replay started
+		uint64_t firstNs  = 0;     ///< time of the current recording's first record
+		uint64_t lastNs   = 0;     ///< when the last record was due, or the replay started
+
+		std::vector<MidiSessionRecord> records;
+	} mReplay;
+	uint64_t mReplayCount = 0; ///< replays started so far
+
+	struct LatencyDump {
+		uint64_t intervalMs = 0;
+		uint64_t lastMs     = 0;
+	} mLatencyDump;
+
+	// true once readBack_ matches config_, false on timeout.
+	bool readBackConfig(const TwisterConfig& config_, TwisterConfig& readBack_);
+
+	std::string mConfigHashPath = "ofxParameterTwister.confighash";
+
+	std::vector<TwisterParam> mParams;
+	size_t mPage = 0;
+
+	std::map<std::string, BindingOptions> mBindingOptions;
+
+	std::map<std::string, Preset> mPresets;
+
+	std::function<void(const TwisterEvent&)> mEventHandler;
+	std::map<std::pair<TwisterEvent::Type, uint8_t>, std::function<void()>> mActions;
+	Morph mMorph;
+
+	std::array<TwisterCore::Encoder, 16> mEncoders;
+
+};
+
+} // close namespace Kontrol
+} // close namespace pal
@@ -0,0 +1,92 @@
+#include "TwisterLog.h"
+
+#include <atomic>
+#include <iostream>
+
+using namespace pal::Kontrol;
+
+namespace {
+
+const char* kLevelNames[] = {
+	"verbose",
+	"notice",
+	"warning",
+	"error",
+	"silent",
+};
+
+// ------------------------------------------------------
+
+void consoleHandler(TwisterLogLevel level_, const char* module_, const std::string& message_) {
+	std::ostream& out = level_ >= TWISTER_LOG_WARNING ? std::cerr : std::cout;
+	out << "[" << kLevelNames[level_] << "] ";
+	if (module_[0] != '\0') {
+		out << module_ << ": ";
+	}
+	out << message_ << std::endl;
+}
+
+// ------------------------------------------------------
+
+std::atomic<int>               gLevel{ TWISTER_LOG_NOTICE };
+std::atomic<TwisterLogHandler> gHandler{ &consoleHandler };
+
+} // close anonymous namespace
+
+// ------------------------------------------------------
+
+void pal::Kontrol::setTwisterLogLevel(TwisterLogLevel level_) {
+	gLevel.store(level_, std::memory_order_relaxed);
+}
+
+// ------------------------------------------------------
+
+TwisterLogLevel pal::Kontrol::getTwisterLogLevel() {
+	return TwisterLogLevel(gLevel.load(std::memory_order_relaxed));
+}
+
+// ------------------------------------------------------
+
+bool pal::Kontrol::isTwisterLogged(TwisterLogLevel level_) {
+	return level_ != TWISTER_LOG_SILENT && level_ >= gLevel.load(std::memory_order_relaxed);
+}
+
+// ------------------------------------------------------
+
+void pal::Kontrol::setTwisterLogHandler(TwisterLogHandler handler_) {
+	gHandler.store(handler_ ? handler_ : &consoleHandler);
+}
+
+// ------------------------------------------------------
+
+TwisterLog::TwisterLog(TwisterLogLevel level_, const char* module_)
+	: mLevel(level_)
+	, mModule(module_)
+	, mMessage(isTwisterLogged(level_) ? new std::ostringstream : nullptr) {
+}
+
+// ------------------------------------------------------
+
+TwisterLog::~TwisterLog() {
+	if (mMessage) {
+		gHandler.load()(mLevel, mModule, mMessage->str());
+	}
+}
+
+// ------------------------------------------------------
+
+TwisterLog& TwisterLog::operator<<(std::ostream& (*manipulator_)(std::ostream&)) {
+	if (mMessage) {
+		manipulator_(*mMessage);
+	}
+	return *this;
+}
+
+// ------------------------------------------------------
+
+TwisterLog& TwisterLog::operator<<(std::ios_base& (*manipulator_)(std::ios_base&)) {
+	if (mMessage) {
+		manipulator_(*mMessage);
+	}
+	return *this;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+namespace pal {
+namespace Kontrol {
+
+/*
+
+Logging for the framework-free core, in the manner of ofLog:
+
+	TwisterLog(TWISTER_LOG_NOTICE) << "Twister config uploaded.";
+
+Messages below the log level are not formatted, and cost no more than
+a level check, so that logging may stay on hot paths. Messages which pass
+go to the log handler - by default, one which prints to the console.
+ofxParameterTwister installs a handler which passes messages on to
+ofLog, and follows ofGetLogLevel().
+
+The level and the handler may be read from any thread, the midi
+input thread included.
+
+*/
+
+enum TwisterLogLevel {
+	TWISTER_LOG_VERBOSE,
+	TWISTER_LOG_NOTICE,
+	TWISTER_LOG_WARNING,
+	TWISTER_LOG_ERROR,
+	TWISTER_LOG_SILENT,
+};
+
+typedef void (*TwisterLogHandler)(TwisterLogLevel level_, const char* module_, const std::string& message_);
+
+void setTwisterLogLevel(TwisterLogLevel level_);
+TwisterLogLevel getTwisterLogLevel();
+bool isTwisterLogged(TwisterLogLevel level_);
+
+// nullptr restores the console handler.
+void setTwisterLogHandler(TwisterLogHandler handler_);
+
+// ------------------------------------------------------
+
+class TwisterLog
+{
+public:
+	explicit TwisterLog(TwisterLogLevel level_, const char* module_ = "");
+	~TwisterLog();
+
+	TwisterLog(const TwisterLog&) = delete;
+	TwisterLog& operator=(const TwisterLog&) = delete;
+
+	template <typename T>
+	TwisterLog& operator<<(const T& value_) {
+		if (mMessage) {
+			*mMessage << value_;
+		}
+		return *this;
+	}
+
+	// manipulators, such as std::hex
+	TwisterLog& operator<<(std::ostream& (*manipulator_)(std::ostream&));
+	TwisterLog& operator<<(std::ios_base& (*manipulator_)(std::ios_base&));
+
+private:
+	TwisterLogLevel mLevel;
+	const char*     mModule;
+
+	std::unique_ptr<std::ostringstream> mMessage; ///< only if the message is logged
+};
+
+} // close namespace Kontrol
+} // close namespace pal
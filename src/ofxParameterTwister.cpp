@@ -1,384 +1,209 @@
 #include "ofxParameterTwister.h"
 
-#include "RtMidi.h"
-
-#include "ofParameter.h"
+#include "ofLog.h"
+#include "ofUtils.h"
 
 using namespace pal::Kontrol;
 
-// ------------------------------------------------------
-/// \brief		static callback for midi controller
-/// \detail		all this callback does is translate the message into a midi messge object
-/// and then pass is on to a the midi in thread channel
-/// so it can be processed in update.
-void _midi_callback(double deltatime, std::vector< unsigned char > *message, void *threadChannel)
-{
-	unsigned int nBytes = message->size();
-
-	auto tCh = static_cast<ofThreadChannel<MidiCCMessage>*>(threadChannel);
-
-	// message will come in three bytes, with the first byte == 176.
+namespace {
 
-	if (message->size() == 3) {
+const char* kConfigHashFile = "ofxParameterTwister.confighash";
 
-		MidiCCMessage msg;
-		msg.command_channel = message->at(0);
-		msg.controller = message->at(1);
-		msg.value = message->at(2);
+// ------------------------------------------------------
 
-		ostringstream ostr;
-		ostr
-			<< std::hex << 1 * msg.getCommand() << " : "
-			<< std::hex << 1 * msg.getChannel() << " : "
-			<< std::hex << 1 * msg.controller << " : "
-			<< std::hex << 1 * msg.value;
+TwisterLogLevel toTwisterLogLevel(ofLogLevel level_) {
+	switch (level_) {
+	case OF_LOG_VERBOSE:
+		return TWISTER_LOG_VERBOSE;
+	case OF_LOG_NOTICE:
+		return TWISTER_LOG_NOTICE;
+	case OF_LOG_WARNING:
+		return TWISTER_LOG_WARNING;
+	case OF_LOG_SILENT:
+		return TWISTER_LOG_SILENT;
+	default:
+		return TWISTER_LOG_ERROR;
+	}
+}
 
-		ofLogVerbose() << ostr.str();
+// ------------------------------------------------------
 
-		tCh->send(std::move(msg));
+// passes the core's log messages on to ofLog.
+void logToOf(TwisterLogLevel level_, const char* module_, const std::string& message_) {
+	switch (level_) {
+	case TWISTER_LOG_VERBOSE:
+		ofLogVerbose(module_) << message_;
+		break;
+	case TWISTER_LOG_NOTICE:
+		ofLogNotice(module_) << message_;
+		break;
+	case TWISTER_LOG_WARNING:
+		ofLogWarning(module_) << message_;
+		break;
+	case TWISTER_LOG_ERROR:
+		ofLogError(module_) << message_;
+		break;
+	default:
+		break;
 	}
 }
 
 // ------------------------------------------------------
 
-ofxParameterTwister::~ofxParameterTwister() {
-	if (mMidiIn != nullptr) {
-		mMidiIn->closePort();
-		delete mMidiIn;
-		mMidiIn = nullptr;
-	}
-	if (mMidiOut != nullptr) {
-		mMidiOut->closePort();
-		delete mMidiOut;
-		mMidiOut = nullptr;
-	}
+// the core filters log messages before they are formatted,
+// so it needs to know what ofLog would let through.
+void followOfLogLevel() {
+	setTwisterLogLevel(toTwisterLogLevel(ofGetLogLevel()));
 }
 
+} // close anonymous namespace
+
 // ------------------------------------------------------
 
-void ofxParameterTwister::setup() {
+ofxParameterTwister::ofxParameterTwister() {
+	setTwisterLogHandler(&logToOf);
 
-	// establish midi in connection,
-	// and bind callback for midi in.
-	try {
-		mMidiIn = new RtMidiIn();
-		size_t numPorts = mMidiIn->getPortCount();
-		size_t midiPort = -1;
-		const std::string deviceName("Midi Fighter Twister");
-		if (mMidiIn->getPortCount() >= 1)
-		{
-			for (size_t i = 0; i < numPorts; ++i)
-			{
-				if (mMidiIn->getPortName(i).substr(0, deviceName.size()) == deviceName)
-				{
-					midiPort = i;
-					mMidiIn->openPort(midiPort);
-					mMidiIn->setCallback(&_midi_callback, &mChannelMidiIn);
-
-					// Don't ignore sysex, timing, or active sensing messages.
-					mMidiIn->ignoreTypes(true, true, true);
-				}
-			}
-		}
-	}
-	catch (RtMidiError &error)
-	{
-		std::cout << "MIDI input exception:" << std::endl;
-		error.printMessage();
-	}
+	mCore.setEventHandler([this](const TwisterEvent& e_) {
+		TwisterEvent ev = e_;
+		ofNotifyEvent(twisterEvent, ev);
+	});
+}
 
-	// establish midi out connection
-	try {
-		mMidiOut = new RtMidiOut();
-		size_t numPorts = mMidiOut->getPortCount();
-		size_t midiPort = -1;
-		const std::string deviceName("Midi Fighter Twister");
-		if (mMidiOut->getPortCount() >= 1)
-		{
-			for (size_t i = 0; i < numPorts; ++i)
-			{
-				if (mMidiOut->getPortName(i).substr(0, deviceName.size()) == deviceName)
-				{
-					midiPort = i;
-					mMidiOut->openPort(midiPort);
-				}
-			}
-		}
-	}
-	catch (RtMidiError &error)
-	{
-		std::cout << "MIDI output exception:" << std::endl;
-		error.printMessage();
-	}
+// ------------------------------------------------------
 
-	// assign ids to encoders
-	for (int i = 0; i < 16; ++i) {
-		mEncoders[i].pos = i;
-		mEncoders[i].mMidiOut = mMidiOut;
-	};
+void ofxParameterTwister::setup(RtMidi::Api api_) {
+	followOfLogLevel();
+	mCore.setConfigHashPath(ofToDataPath(kConfigHashFile));
+	mCore.setup(api_);
 }
 
 // ------------------------------------------------------
 
+void ofxParameterTwister::update() {
+	followOfLogLevel();
+	mCore.update();
+}
 
 // ------------------------------------------------------
 
 void ofxParameterTwister::setParams(const ofParameterGroup& group_)
 {
-	ofLogVerbose() << "Updating mapping" << endl;
 	/*
 
-	based on incoming parameters,
-	we set our Encoders to track them
+	we flatten nested groups once, here, so that
+	page switches only need to walk the cached list.
 
 	*/
 
-	auto it = group_.begin();
-	auto endIt = group_.end();
-
-	for (auto & e : mEncoders) {
-
-		if (it != endIt) {
-			if (auto param = dynamic_pointer_cast<ofParameter<float>>(*it)) {
-				// bingo, we have a float param
-				e.setState(Encoder::State::ROTARY);
-				e.setValue(ofMap(*param, param->getMin(), param->getMax(), 0, 127, true));
-
-				// now set the Encoder's event listener to track 
-				// this parameter
-				auto pMin = param->getMin();
-				auto pMax = param->getMax();
-
-				e.updateParameter = [=](uint8_t v_) {
-					// on midi input
-					param->set(ofMap(v_, 0, 127, pMin, pMax, true));
-				};
-
-				e.mELParamChange = param->newListener([&e, pMin, pMax](float v_) {
-					// on parameter change, write from parameter 
-					// to midi.
-					e.setValue(ofMap(v_, pMin, pMax, 0, 127, true));
-				});
-
-			} else if (auto param = dynamic_pointer_cast<ofParameter<bool>>(*it)) {
-				// we have a bool parameter
-				e.setState(Encoder::State::SWITCH);
-				e.setValue((*param == true) ? 127 : 0);
-				
-				e.updateParameter = [=](uint8_t v_) {
-					param->set((v_ > 63) ? true : false);
-				};
-
-				e.mELParamChange = param->newListener([&e](bool v_) {
-					e.setValue(v_ == true ? 127 : 0);
-				});
-
-			} else {
-				// we cannot match this parameter, unfortunately
-				e.setState(Encoder::State::DISABLED);
-				e.mELParamChange = ofEventListener(); // reset listener
-			}
-			
-			it++;
-
-		} else {
-			// no more parameters to map.
-			e.setState(Encoder::State::DISABLED, true);
-		}
-	}
+	mParams = group_;
 
-}
+	mFlatParams.clear();
+	flattenParams(group_, "", mFlatParams);
 
-// ------------------------------------------------------
+	std::vector<TwisterParam> params;
+	params.reserve(mFlatParams.size());
 
-void ofxParameterTwister::update() {
+	for (auto & leaf : mFlatParams) {
+		TwisterParam p;
+		p.path = leaf.path;
 
-	MidiCCMessage m;
-
-	while (mChannelMidiIn.tryReceive(m)) {
-
-		// we got a message.
-		
-		// let's get the address.
-
-		if (m.getCommand() == 0xB) {
-
-			if (m.getChannel() == 0x0) {
-				// rotary message
-				size_t encoderID = m.controller;
-				auto &e = mEncoders[encoderID];
-				if (e.mState == Encoder::State::ROTARY)
-					if (e.updateParameter)
-						e.updateParameter(m.value);
-			}
-
-			if (m.getChannel() == 0x1) {
-				// rotary message
-				size_t encoderID = m.controller;
-				auto &e = mEncoders[encoderID];
-				if (e.mState == Encoder::State::SWITCH)
-					if (e.updateParameter)
-						e.updateParameter(m.value);
-			}
+		switch (leaf.type)
+		{
+		case FlatParam::Type::FLOAT:
+		{
+			auto param = leaf.paramFloat;
+			p.type = TwisterParam::Type::FLOAT;
+			p.min  = param->getMin();
+			p.max  = param->getMax();
+			p.get  = [param]() { return param->get(); };
+			p.set  = [param](float v_) { param->set(v_); };
+			p.listen = [param](std::function<void(float)> onChange_) {
+				return std::shared_ptr<void>(std::make_shared<ofEventListener>(param->newListener([onChange_](float v_) {
+					onChange_(v_);
+				})));
+			};
+		}
+			break;
+		case FlatParam::Type::BOOL:
+		{
+			auto param = leaf.paramBool;
+			p.type = TwisterParam::Type::BOOL;
+			p.get  = [param]() { return param->get() ? 1.f : 0.f; };
+			p.set  = [param](float v_) { param->set(v_ >= 0.5f); };
+			p.listen = [param](std::function<void(float)> onChange_) {
+				return std::shared_ptr<void>(std::make_shared<ofEventListener>(param->newListener([onChange_](bool v_) {
+					onChange_(v_ ? 1.f : 0.f);
+				})));
+			};
+		}
+			break;
+		default:
+			break;
 		}
-	}
-}
-
-// ------------------------------------------------------
-
-void pal::Kontrol::ofxParameterTwister::Encoder::setState(State s_, bool force_)
-{
-	if (s_ == mState && force_ == false) {
-		return;
-	}
 
-	// ----------| invariant: state change requested, or forced
-
-	switch (s_)
-	{
-	case pal::Kontrol::ofxParameterTwister::Encoder::State::DISABLED:
-		setEncoderAnimation(0);
-		// we need to switch off the status LED
-		sendToSwitch(0);
-		// we need to switch off the rotary status LED
-		sendToRotary(0);
-		setBrightnessRotary(0.f);
-		setBrightnessRGB(1.f);
-		break;
-	case pal::Kontrol::ofxParameterTwister::Encoder::State::ROTARY:
-		sendToSwitch(0);
-		setBrightnessRotary(1.f);
-		setBrightnessRGB(0.0f);
-		break;
-	case pal::Kontrol::ofxParameterTwister::Encoder::State::SWITCH:
-		sendToRotary(0);
-		setBrightnessRotary(0.f);
-		setBrightnessRGB(1.0f);
-		setEncoderAnimation(65);
-		break;
-	default:
-		break;
+		params.emplace_back(std::move(p));
 	}
 
-	mState = s_;
+	mCore.setParams(std::move(params));
 }
 
 // ------------------------------------------------------
 
-void pal::Kontrol::ofxParameterTwister::Encoder::setValue(uint8_t v_) {
-
-	switch (mState)
-	{
-	case pal::Kontrol::ofxParameterTwister::Encoder::State::DISABLED:
-		ofLogError() << "cannot send value to diabled encoder" << pos;
-		break;
-	case pal::Kontrol::ofxParameterTwister::Encoder::State::ROTARY:
-		sendToRotary(v_);
-		break;
-	case pal::Kontrol::ofxParameterTwister::Encoder::State::SWITCH:
-		sendToSwitch(v_);
-		break;
-	default:
-		break;
-	}
+void ofxParameterTwister::flattenParams(const ofParameterGroup& group_, const std::string& prefix_, std::vector<FlatParam>& flat_) {
 
-}
+	for (auto & p : group_) {
 
-// ------------------------------------------------------
+		if (auto group = dynamic_pointer_cast<ofParameterGroup>(p)) {
+			// descend into sub-group, depth-first
+			flattenParams(*group, prefix_ + group->getName() + "/", flat_);
+			continue;
+		}
 
-void pal::Kontrol::ofxParameterTwister::Encoder::sendToSwitch(uint8_t v_) {
-	if (mMidiOut == nullptr)
-		return;
+		// ----------| invariant: p is a leaf parameter
 
-	// ----------| invariant: midiOut is not nullptr
+		FlatParam leaf;
+		leaf.path = prefix_ + p->getName();
 
-	vector<unsigned char> msg{
-		0xB1,					// SWITCH listens on channel 1
-		pos,					// device id
-		v_,						// value
-	};
-	mMidiOut->sendMessage(&msg);
+		if (auto param = dynamic_pointer_cast<ofParameter<float>>(p)) {
+			leaf.type = FlatParam::Type::FLOAT;
+			leaf.paramFloat = param;
+		} else if (auto param = dynamic_pointer_cast<ofParameter<bool>>(p)) {
+			leaf.type = FlatParam::Type::BOOL;
+			leaf.paramBool = param;
+		}
 
-	ofLogVerbose() << ">>" << setw(2) << 1 * pos << " SWI " << " : " << setw(3) << v_ * 1;
+		// unsupported parameters keep their slot, so that
+		// the layout on the twister follows the group's layout.
+		flat_.emplace_back(std::move(leaf));
+	}
 }
 
 // ------------------------------------------------------
 
-void pal::Kontrol::ofxParameterTwister::Encoder::sendToRotary(uint8_t v_) {
-	if (mMidiOut == nullptr)
-		return;
-
-	// ----------| invariant: midiOut is not nullptr
-
-	vector<unsigned char> msg{
-		0xB0,					// ROTARY listens on channel 0
-		pos,					// device id
-		v_,						// value
-	};
-
-	mMidiOut->sendMessage(&msg);
-
-	ofLogVerbose() << ">>" << setw(2) << 1 * pos << " ROT " << " : " << setw(3) << v_ * 1;
+const std::vector<ofxParameterTwister::FlatParam>& ofxParameterTwister::getFlatParams() const {
+	return mFlatParams;
 }
 
 // ------------------------------------------------------
 
-void pal::Kontrol::ofxParameterTwister::Encoder::setBrightnessRotary(float b_)
-{
-	if (mMidiOut == nullptr)
-		return;
-
-	// ----------| invariant: midiOut is not nullptr
-
-	unsigned char val = std::roundf(ofMap(b_, 0.f, 1.f, 65, 95, true));
-	
-	vector<unsigned char> msg{
-		0xB2,					// animation control channel 2
-		pos,					// device id
-		val,
-	};
-
-	mMidiOut->sendMessage(&msg);
-
+bool ofxParameterTwister::uploadConfig(const std::string& mfsPath_, bool force_) {
+	return mCore.uploadConfig(ofToDataPath(mfsPath_), force_);
 }
 
 // ------------------------------------------------------
 
-void pal::Kontrol::ofxParameterTwister::Encoder::setBrightnessRGB(float b_)
-{
-	if (mMidiOut == nullptr)
-		return;
-
-	// ----------| invariant: midiOut is not nullptr
-
-	unsigned char val = std::roundf(ofMap(b_, 0.f, 1.f, 17, 47, true));
-
-	vector<unsigned char> msg{
-		0xB2,					// animation control channel 2 
-		pos,					// device id
-		val,
-	};
-
-	mMidiOut->sendMessage(&msg);
-
+bool ofxParameterTwister::startRecording(const std::string& path_) {
+	return mCore.startRecording(ofToDataPath(path_));
 }
-// ------------------------------------------------------
 
 // ------------------------------------------------------
 
-void pal::Kontrol::ofxParameterTwister::Encoder::setEncoderAnimation(uint8_t v_)
-{
-	if (mMidiOut == nullptr)
-		return;
-
-	// ----------| invariant: midiOut is not nullptr
-
-	vector<unsigned char> msg{
-		0xB2,					// animation control channel 2
-		pos,					// device id
-		v_,
-	};
+bool ofxParameterTwister::startReplay(const std::string& path_, bool realtime_) {
+	return mCore.startReplay(ofToDataPath(path_), realtime_);
+}
 
-	mMidiOut->sendMessage(&msg);
+// ------------------------------------------------------
 
+bool ofxParameterTwister::writeTrace(const std::string& path_) const {
+	return mCore.writeTrace(ofToDataPath(path_));
 }
@@ -1,10 +1,9 @@
 #pragma once
 
 #include <memory>
-#include <array>
-#include "ofThreadChannel.h"
 #include "ofParameter.h"
-#include "RtMidi.h"
+#include "ofEvents.h"
+#include "TwisterCore.h"
 
 
 class ofAbstractParameter;
@@ -27,98 +26,119 @@ class ofAbstractParameter;
   parameter change outside of twister is sent to twister
   whilst parameters are bound to twister.
 
+the engine is TwisterCore, which does not depend on openFrameworks;
+this owns one, binds it to ofParameters, passes twister events on to
+an ofEvent, routes its log to ofLog, and resolves paths against the
+data folder. the core is not exposed, so that nothing reaches it
+around these.
+
 */
 #include <cstdint> ///< we include this to get access to standard sized types
 
 namespace pal {
 namespace Kontrol {
 
-struct MidiCCMessage {
-	uint8_t command_channel = 0xB0;
-	uint8_t controller = 0x00;
-	uint8_t value = 0x00;
+class ofxParameterTwister
+{
 
-	int getCommand() {
-		// command is in the most significant 
-		// 4 bits, so we shift 4 bits to the right.
-		// e.g. 0xB0
-		return command_channel >> 4;
-	};
+public:
 
-	int getChannel() {
-		// channel is the least significant 4 bits,
-		// so we null out the high bits
-		return command_channel & 0x0F;
+	// a leaf parameter, found by walking a (possibly nested)
+	// parameter group depth-first.
+	struct FlatParam {
+		enum class Type {
+			UNSUPPORTED,
+			FLOAT,
+			BOOL,
+		} type = Type::UNSUPPORTED;
+
+		std::string path; ///< names of enclosing groups and parameter, separated by '/'
+
+		// typed parameter handles - casts happen once, when flattening,
+		// so that switching pages does not need to cast again.
+		std::shared_ptr<ofParameter<float>> paramFloat;
+		std::shared_ptr<ofParameter<bool>>  paramBool;
 	};
 
-};
+	ofxParameterTwister();
 
+	// see TwisterCore::setup
+	void setup(RtMidi::Api api_ = RtMidi::UNSPECIFIED);
 
+	void update(); // this is where we apply values.
+	void setParams(const ofParameterGroup& group_);
 
+	const std::vector<FlatParam>& getFlatParams() const;
 
-class ofxParameterTwister
-{
+	// all twister events are notified here, from within update().
+	ofEvent<TwisterEvent> twisterEvent;
 
-	struct Encoder {
+	// as in TwisterCore, with paths relative to the data folder.
+	// the hash of the last config uploaded is cached there, too.
+	bool uploadConfig(const std::string& mfsPath_, bool force_ = false);
+	bool startRecording(const std::string& path_);
+	bool startReplay(const std::string& path_, bool realtime_ = true);
+	bool writeTrace(const std::string& path_) const;
 
-		RtMidiOut*	mMidiOut = nullptr;
+	// the rest is TwisterCore's, as is - see there.
+	void setRealtimeInput(bool enabled_, int priority_ = 80, int cpu_ = -1) { mCore.setRealtimeInput(enabled_, priority_, cpu_); }
+	bool isInputRealtime() const { return mCore.isInputRealtime(); }
+	void setClock(Clock* clock_) { mCore.setClock(clock_); }
 
-		// position on the controller left to right,
-		// top to bottom
-		uint8_t pos = 0;
+	const std::vector<TwisterParam>& getParams() const { return mCore.getParams(); }
 
-		// knob may be either 
-		// disabled, or a rotary controller, or a switch.
-		enum class State {
-			DISABLED,
-			ROTARY,
-			SWITCH
-		} mState = State::DISABLED;
+	size_t getPage() const { return mCore.getPage(); }
+	size_t getNumPages() const { return mCore.getNumPages(); }
+	void   setPage(size_t page_) { mCore.setPage(page_); }
+	void   nextPage() { mCore.nextPage(); }
+	void   previousPage() { mCore.previousPage(); }
 
-		// internal representation of the knob value 
-		// may be 0..127
-		uint8_t value = 0;
+	void setResponseCurve(const std::string& path_, const ResponseCurve& curve_) { mCore.setResponseCurve(path_, curve_); }
+	void setPickupMode(const std::string& path_, bool enabled_) { mCore.setPickupMode(path_, enabled_); }
 
-		// event listener for parameter change
-		ofEventListener mELParamChange;
+	void storePreset(const std::string& name_) { mCore.storePreset(name_); }
+	bool recallPreset(const std::string& name_, uint64_t morphMillis_ = 0) { return mCore.recallPreset(name_, morphMillis_); }
+	bool isMorphing() const { return mCore.isMorphing(); }
 
-		std::function<void(uint8_t v_)> updateParameter;
+	void bindAction(TwisterEvent::Type type_, uint8_t id_, std::function<void()> action_) { mCore.bindAction(type_, id_, std::move(action_)); }
+	void clearActions() { mCore.clearActions(); }
 
-		void setState(State s_, bool force_ = false);
-		void setValue(uint8_t v_);
+	void scheduleMessage(const MidiCCMessage& m_, double delaySeconds_) { mCore.scheduleMessage(m_, delaySeconds_); }
+	void cancelScheduledMessages() { mCore.cancelScheduledMessages(); }
 
-		void sendToSwitch(uint8_t v_);
-		void sendToRotary(uint8_t v_);
+	bool uploadConfig(const TwisterConfig& config_, bool force_ = false) { return mCore.uploadConfig(config_, force_); }
 
-		void setEncoderAnimation(uint8_t v_);
-		void setBrightnessRotary(float b_); /// brightness is normalised over 31 steps 0..30
-		void setBrightnessRGB(float b_);
-	};
+	void setLatencyTracking(bool enabled_, uint64_t dumpIntervalMs_ = 0) { mCore.setLatencyTracking(enabled_, dumpIntervalMs_); }
+	bool isLatencyTracking() const { return mCore.isLatencyTracking(); }
+	const LatencyHistogram& getLatency(LatencyStage stage_) const { return mCore.getLatency(stage_); }
+	void resetLatency() { mCore.resetLatency(); }
+	void logLatency() const { mCore.logLatency(); }
 
+	TwisterStats::Snapshot getStats() const { return mCore.getStats(); }
+	void resetStats() { mCore.resetStats(); }
 
-public:
-	
-	
-	~ofxParameterTwister();
+	void stopRecording() { mCore.stopRecording(); }
+	bool isRecording() const { return mCore.isRecording(); }
+	void stopReplay() { mCore.stopReplay(); }
+	bool isReplaying() const { return mCore.isReplaying(); }
 
-	void setup();
+	void setTracing(bool enabled_) { mCore.setTracing(enabled_); }
+	bool isTracing() const { return mCore.isTracing(); }
+	void clearTrace() { mCore.clearTrace(); }
 
-	void update(); // this is where we apply values.
-	void setParams(const ofParameterGroup& group_);
+	void injectInput(const RtMidiMessage* messages_, unsigned int count_) { mCore.injectInput(messages_, count_); }
 
 private:
 
-	RtMidiIn*	mMidiIn = nullptr;
-	RtMidiOut*	mMidiOut = nullptr;
-
-	ofThreadChannel<MidiCCMessage> mChannelMidiIn;
+	static void flattenParams(const ofParameterGroup& group_, const std::string& prefix_, std::vector<FlatParam>& flat_);
 
 	ofParameterGroup mParams;
 
-	std::array<ofxParameterTwister::Encoder, 16> mEncoders;
+	std::vector<FlatParam> mFlatParams; ///< cached leaf parameters of mParams, depth-first
+
+	TwisterCore mCore;
 
 };
 
 } // close namespace Kontrol
 } // close namespace pal
-
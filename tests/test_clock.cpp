@@ -0,0 +1,259 @@
+/*
+
+Tests timing on a VirtualClock: that a recorded session replays with
+exact timing - recordings appended to the session included - that
+input latency measures exactly what the clock says, that loopback
+input is stamped on the clock of the core it arrives at, and that
+traces time spans in real time, while midi arrivals keep their stamp.
+
+	test_clock <scratch directory>
+
+*/
+
+#include "TwisterCore.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <thread>
+
+using namespace pal::Kontrol;
+
+namespace {
+
+const uint64_t kMs = 1000000;
+
+int gFailures = 0;
+
+void check(bool ok_, const char* what_) {
+	if (!ok_) {
+		std::fprintf(stderr, "FAILED: %s\n", what_);
+		++gFailures;
+	}
+}
+
+// ------------------------------------------------------
+
+MidiSessionRecord shiftRotate(uint64_t timeNs_, uint8_t encoder_) {
+	MidiSessionRecord r{};
+	r.timeNs          = timeNs_;
+	r.command_channel = 0xB4;
+	r.controller      = encoder_;
+	r.value           = 65;
+	return r;
+}
+
+// ------------------------------------------------------
+
+void testReplay(const std::string& scratch_) {
+	const std::string path = scratch_ + "/test_clock.twses";
+	std::remove(path.c_str());
+
+	// two recordings, with epochs of their own: the second one
+	// was recorded on a clock which reads earlier.
+	{
+		MidiSessionWriter writer;
+		check(writer.open(path, 5000 * kMs), "session opens");
+		const MidiSessionRecord first[] = {
+			shiftRotate(5010 * kMs, 0),
+			shiftRotate(5110 * kMs, 1),
+			shiftRotate(5360 * kMs, 2),
+		};
+		writer.append(first, 3);
+		writer.close();
+
+		check(writer.open(path, 2000 * kMs), "session opens for appending");
+		const MidiSessionRecord second[] = {
+			shiftRotate(2040 * kMs, 3),
+			shiftRotate(2240 * kMs, 4),
+		};
+		writer.append(second, 2);
+		writer.close();
+	}
+
+	VirtualClock clock;
+	TwisterCore twister;
+	twister.setClock(&clock);
+
+	struct Arrival {
+		uint8_t  id;
+		uint64_t timeNs;  ///< the event's stamp
+		uint64_t clockNs; ///< when it was dispatched
+	};
+	std::vector<Arrival> arrivals;
+	twister.setEventHandler([&](const TwisterEvent& e_) {
+		arrivals.push_back({ e_.id, e_.timeNs, clock.nowNs() });
+	});
+
+	const uint64_t startNs = clock.nowNs();
+	check(twister.startReplay(path), "session replays");
+
+	// one frame per millisecond.
+	for (int frame = 0; frame < 1000 && twister.isReplaying(); ++frame) {
+		twister.update();
+		clock.advanceMs(1);
+	}
+
+	// the first recording plays from its first message on; the second
+	// one follows right after the first recording's last message.
+	const uint64_t expectedMs[] = { 0, 100, 350, 350, 550 };
+
+	check(!twister.isReplaying(), "replay ends");
+	check(arrivals.size() == 5, "every recorded message replays");
+	for (size_t i = 0; i < arrivals.size() && i < 5; ++i) {
+		check(arrivals[i].id == i, "messages replay in order");
+		check(arrivals[i].timeNs == startNs + expectedMs[i] * kMs, "replayed messages are stamped at their exact time");
+		check(arrivals[i].clockNs == arrivals[i].timeNs, "replayed messages are dispatched on the frame they are due");
+	}
+
+	std::remove(path.c_str());
+}
+
+// ------------------------------------------------------
+
+void testLatency() {
+	VirtualClock clock;
+	TwisterCore twister;
+	twister.setClock(&clock);
+	twister.setLatencyTracking(true);
+
+	// stamped by the driver 250 us ago, picked up by update()
+	// 2 ms later.
+	RtMidiMessage messages[4];
+	for (unsigned i = 0; i < 4; ++i) {
+		const uint8_t bytes[3] = { 0xB4, uint8_t(i), 65 };
+		messages[i].assign(bytes, sizeof(bytes));
+		messages[i].timeNs = clock.nowNs() - 250000;
+	}
+	twister.injectInput(messages, 4);
+	clock.advanceMs(2);
+	twister.update();
+
+	const LatencyHistogram& driver   = twister.getLatency(LatencyStage::DRIVER_TO_CALLBACK);
+	const LatencyHistogram& dequeue  = twister.getLatency(LatencyStage::CALLBACK_TO_DEQUEUE);
+	const LatencyHistogram& apply    = twister.getLatency(LatencyStage::DEQUEUE_TO_APPLY);
+	const LatencyHistogram& endToEnd = twister.getLatency(LatencyStage::END_TO_END);
+
+	check(driver.count() == 4 && driver.max() == 250000 && driver.mean() == 250000.0, "driver to callback measures 250 us");
+	check(dequeue.count() == 4 && dequeue.max() == 2 * kMs && dequeue.mean() == 2.0 * kMs, "callback to dequeue measures 2 ms");
+	check(apply.count() == 4 && apply.max() == 0, "dispatch takes no virtual time");
+	check(endToEnd.count() == 4 && endToEnd.max() == 2 * kMs + 250000, "end to end measures 2.25 ms");
+}
+
+// ------------------------------------------------------
+
+// live input arrives on the loopback api's delivery thread; wait for
+// it, in real time.
+bool waitForEvent(TwisterCore& twister_, const std::vector<uint64_t>& stamps_) {
+	const size_t count = stamps_.size();
+	for (int i = 0; i < 1000 && stamps_.size() == count; ++i) {
+		twister_.update();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return stamps_.size() > count;
+}
+
+// ------------------------------------------------------
+
+void testLoopbackClocks() {
+	const std::string portName = "Midi Fighter Twister";
+	const uint8_t shiftRotate[3] = { 0xB4, 0, 65 };
+
+	RtMidiLoopback::createPort(portName, false, false);
+	{
+		VirtualClock clockA(1000 * kMs);
+		VirtualClock clockB(9000 * kMs);
+		std::vector<uint64_t> stampsA, stampsB;
+
+		auto twisterA = std::unique_ptr<TwisterCore>(new TwisterCore);
+		twisterA->setClock(&clockA);
+		twisterA->setEventHandler([&](const TwisterEvent& e_) { stampsA.push_back(e_.timeNs); });
+		twisterA->setup(RtMidi::LOOPBACK);
+
+		TwisterCore twisterB;
+		twisterB.setClock(&clockB);
+		twisterB.setEventHandler([&](const TwisterEvent& e_) { stampsB.push_back(e_.timeNs); });
+		twisterB.setup(RtMidi::LOOPBACK);
+
+		// both cores have the port open, and each stamps what it
+		// receives on its own clock.
+		RtMidiLoopback::inject(portName, shiftRotate, sizeof(shiftRotate));
+		check(waitForEvent(*twisterA, stampsA) && stampsA.back() == clockA.nowNs(), "loopback input is stamped on the first core's clock");
+		check(waitForEvent(twisterB, stampsB) && stampsB.back() == clockB.nowNs(), "loopback input is stamped on the second core's clock");
+
+		// a core going away leaves the other one's clock in place.
+		twisterA.reset();
+		clockB.advanceMs(5);
+		RtMidiLoopback::inject(portName, shiftRotate, sizeof(shiftRotate));
+		check(waitForEvent(twisterB, stampsB) && stampsB.back() == clockB.nowNs(), "loopback input keeps its clock when another core goes away");
+	}
+	RtMidiLoopback::removePort(portName);
+}
+
+// ------------------------------------------------------
+
+void testTrace(const std::string& scratch_) {
+	const std::string path = scratch_ + "/test_clock.trace.json";
+
+	VirtualClock clock(7 * kMs);
+	TwisterCore twister;
+	twister.setClock(&clock);
+	twister.setTracing(true);
+
+	// stamped 250 us ago on the virtual clock, by the driver.
+	RtMidiMessage message;
+	const uint8_t bytes[3] = { 0xB4, 0, 65 };
+	message.assign(bytes, sizeof(bytes));
+	message.timeNs = clock.nowNs() - 250000;
+	twister.injectInput(&message, 1);
+
+	const uint64_t beforeNs = SteadyClock::instance().nowNs();
+	twister.update();
+	const uint64_t afterNs = SteadyClock::instance().nowNs();
+
+	check(twister.writeTrace(path), "trace writes");
+	std::ifstream file(path);
+	const std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	// 6.75 ms, in microseconds.
+	check(json.find("{\"name\":\"midi arrival\",\"ph\":\"i\",\"s\":\"t\",\"ts\":6750.000") != std::string::npos, "midi arrivals carry their stamp");
+
+	// while the virtual clock stood still, update() took real time.
+	const std::string update = "{\"name\":\"update\",\"ph\":\"X\",\"ts\":";
+	const size_t at = json.find(update);
+	check(at != std::string::npos, "update() is traced");
+	if (at != std::string::npos) {
+		char* end = nullptr;
+		const double tsUs = std::strtod(json.c_str() + at + update.size(), &end);
+		const double durUs = std::strtod(end + std::string(",\"dur\":").size(), nullptr);
+		check(tsUs >= beforeNs * 1e-3 - 0.001 && tsUs + durUs <= afterNs * 1e-3 + 0.001, "spans are timed on the steady clock");
+	}
+
+	std::remove(path.c_str());
+}
+
+} // close anonymous namespace
+
+// ------------------------------------------------------
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::fprintf(stderr, "usage: %s <scratch directory>\n", argv[0]);
+		return 2;
+	}
+
+	setTwisterLogLevel(TWISTER_LOG_WARNING);
+
+	testReplay(argv[1]);
+	testLatency();
+	testLoopbackClocks();
+	testTrace(argv[1]);
+
+	if (gFailures == 0) {
+		std::printf("test_clock: ok\n");
+	}
+	return gFailures == 0 ? 0 : 1;
+}
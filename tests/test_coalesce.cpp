@@ -0,0 +1,153 @@
+/*
+
+Tests coalescing and stats: that of several rotary messages for one
+encoder which arrive together, only the last is applied - unless some
+other input comes in between, or the encoder waits for pickup - and
+that resetting stats starts every counter afresh.
+
+	test_coalesce
+
+*/
+
+#include "TwisterCore.h"
+
+#include <cstdio>
+#include <initializer_list>
+
+using namespace pal::Kontrol;
+
+namespace {
+
+int gFailures = 0;
+
+void check(bool ok_, const char* what_) {
+	if (!ok_) {
+		std::fprintf(stderr, "FAILED: %s\n", what_);
+		++gFailures;
+	}
+}
+
+// ------------------------------------------------------
+
+struct Message {
+	uint8_t status, controller, value;
+};
+
+// messages_ arrive in one batch, and are applied in one update().
+void arrive(TwisterCore& twister_, std::initializer_list<Message> messages_) {
+	std::vector<RtMidiMessage> batch(messages_.size());
+	size_t i = 0;
+	for (const Message& m : messages_) {
+		const uint8_t bytes[3] = { m.status, m.controller, m.value };
+		batch[i++].assign(bytes, sizeof(bytes));
+	}
+	twister_.injectInput(batch.data(), unsigned(batch.size()));
+	twister_.update();
+}
+
+// ------------------------------------------------------
+
+void testCoalescing() {
+	TwisterCore twister;
+
+	// midi values applied to encoder 0's and 1's parameters, in order.
+	TwisterValue v0, v1;
+	std::vector<uint8_t> applied;
+	std::vector<TwisterParam> params = { v0.param("p0", 0.f, 127.f), v1.param("p1", 0.f, 127.f) };
+	for (auto& p : params) {
+		auto set = p.set;
+		p.set = [set, &applied](float v_) {
+			applied.push_back(uint8_t(v_ + 0.5f));
+			set(v_);
+		};
+	}
+	twister.setParams(params);
+
+	auto coalesced = [&twister]() {
+		const uint64_t n = twister.getStats().coalesced;
+		twister.resetStats();
+		return n;
+	};
+	coalesced();
+
+	// a run of rotary messages: only the last one per encoder counts.
+	applied.clear();
+	arrive(twister, { { 0xB0, 0, 10 }, { 0xB0, 1, 50 }, { 0xB0, 0, 20 }, { 0xB0, 1, 60 }, { 0xB0, 0, 30 } });
+	check(applied == std::vector<uint8_t>({ 60, 30 }), "a run of rotary messages applies each encoder's last value");
+	check(coalesced() == 3, "superseded rotary messages are counted as coalesced");
+
+	// a switch in between ends the run.
+	applied.clear();
+	arrive(twister, { { 0xB0, 0, 10 }, { 0xB1, 1, 127 }, { 0xB0, 0, 20 } });
+	check(applied == std::vector<uint8_t>({ 10, 20 }), "a switch between rotary messages stops coalescing");
+	check(coalesced() == 0, "nothing is coalesced across a switch");
+
+	// so do shifted rotation, and a side button or bank change.
+	applied.clear();
+	arrive(twister, { { 0xB0, 0, 10 }, { 0xB4, 0, 65 }, { 0xB0, 0, 20 }, { 0xB3, 9, 127 }, { 0xB0, 0, 30 } });
+	check(applied == std::vector<uint8_t>({ 10, 20, 30 }), "shift and system input between rotary messages stop coalescing");
+	check(coalesced() == 0, "nothing is coalesced across shift or system input");
+
+	// runs either side of other input coalesce on their own.
+	applied.clear();
+	arrive(twister, { { 0xB0, 0, 10 }, { 0xB0, 0, 11 }, { 0xB1, 1, 0 }, { 0xB0, 0, 20 }, { 0xB0, 0, 21 } });
+	check(applied == std::vector<uint8_t>({ 11, 21 }), "runs either side of other input coalesce on their own");
+	check(coalesced() == 2, "each run's superseded messages are counted");
+
+	// pickup needs every value.
+	twister.setPickupMode("p0", true);
+	applied.clear();
+	arrive(twister, { { 0xB0, 0, 10 }, { 0xB0, 0, 20 }, { 0xB0, 0, 30 } });
+	check(coalesced() == 0, "rotary messages for an encoder waiting for pickup are not coalesced");
+}
+
+// ------------------------------------------------------
+
+void testStatsReset() {
+	TwisterCore twister;
+	TwisterValue v0;
+	twister.setParams({ v0.param("p0") });
+
+	arrive(twister, { { 0xB0, 0, 10 }, { 0xB0, 0, 20 }, { 0xB0, 40, 1 }, { 0x90, 1, 1 }, { 0xB2, 0, 1 } });
+	TwisterStats::Snapshot s = twister.getStats();
+	check(s.received[0] == 3 && s.received[2] == 1 && s.rejected == 1, "input is counted");
+	check(s.coalesced == 1 && s.outOfRange == 1 && s.ignored == 1, "dispatch is counted");
+
+	twister.resetStats();
+	s = twister.getStats();
+	const TwisterStats::Snapshot zero;
+	bool cleared = true;
+	for (size_t c = 0; c < s.received.size(); ++c) {
+		cleared &= (s.received[c] == 0);
+	}
+	cleared &= s.rejected == 0 && s.dropped == 0 && s.dispatched == 0 && s.coalesced == 0 && s.ignored == 0;
+	cleared &= s.outOfRange == 0 && s.sent == 0 && s.bytesOut == 0 && s.sendErrors == 0 && s.reconnects == 0;
+	cleared &= s.queued == zero.queued && s.queueHighWater == zero.queueHighWater;
+	check(cleared, "reset clears every counter");
+
+	// counting resumes from the new baseline.
+	arrive(twister, { { 0xB0, 0, 30 }, { 0xB0, 0, 40 } });
+	s = twister.getStats();
+	check(s.received[0] == 2 && s.dispatched == 1 && s.coalesced == 1 && s.rejected == 0 && s.outOfRange == 0, "counting resumes from the new baseline");
+	check(s.queueHighWater == 2, "the queue's high water mark restarts from the reset");
+
+	// a second reset moves the baseline again.
+	twister.resetStats();
+	check(twister.getStats().received[0] == 0, "a second reset moves the baseline again");
+}
+
+} // close anonymous namespace
+
+// ------------------------------------------------------
+
+int main() {
+	setTwisterLogLevel(TWISTER_LOG_WARNING);
+
+	testCoalescing();
+	testStatsReset();
+
+	if (gFailures == 0) {
+		std::printf("test_coalesce: ok\n");
+	}
+	return gFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,203 @@
+/*
+
+Tests device configuration: that data/mapping.mfs survives a parse
+and serialize round trip, and that uploadConfig() sends the config
+over sysex, verifies it against what a device replies, and skips an
+unchanged config.
+
+The device is simulated on the loopback api. It answers from within
+the core's clock: whenever the core waits for the device, the clock
+reads what the core sent, and injects replies. The clock is virtual,
+so the paced upload and the read-back timeout take no real time.
+
+	test_config <path to mapping.mfs> <scratch directory>
+
+*/
+
+#include "TwisterCore.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <map>
+
+using namespace pal::Kontrol;
+
+namespace {
+
+const std::string kPortName = "Midi Fighter Twister";
+
+int gFailures = 0;
+
+void check(bool ok_, const char* what_) {
+	if (!ok_) {
+		std::fprintf(stderr, "FAILED: %s\n", what_);
+		++gFailures;
+	}
+}
+
+// ------------------------------------------------------
+
+std::vector<uint8_t> readFile(const std::string& path_) {
+	std::ifstream file(path_, std::ios::binary);
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+// ------------------------------------------------------
+
+// a twister, as far as configs are concerned: it keeps what is
+// uploaded, and replies to pull requests with it.
+class DeviceClock : public VirtualClock
+{
+public:
+	TwisterCore* twister  = nullptr;
+	bool         answer   = true;
+
+	std::vector<std::vector<uint8_t>> uploaded; ///< config messages, in the order sent
+	size_t                            pulls = 0;
+
+	void sleepNs(uint64_t ns_) override {
+		VirtualClock::sleepNs(ns_);
+
+		for (const auto& m : RtMidiLoopback::capture(kPortName)) {
+			handle(m);
+		}
+	}
+
+private:
+	// sysex layout: F0, manufacturer (3), command, payload, F7.
+	static const size_t kCommand = 4;
+	static const size_t kSlot    = 6; ///< slot, in a record's header
+
+	std::vector<uint8_t>                globals;
+	std::map<uint8_t, std::vector<uint8_t>> records;
+
+	void handle(const std::vector<uint8_t>& m_) {
+		if (m_.empty() || m_.front() != 0xF0)
+			return; // led and value updates
+
+		if (m_ == TwisterConfig::pullGlobalsRequest()) {
+			++pulls;
+			reply(globals);
+			return;
+		}
+		if (m_.size() <= kSlot)
+			return;
+		if (m_ == TwisterConfig::pullEncoderRequest(m_[kSlot])) {
+			++pulls;
+			reply(records[m_[kSlot]]);
+			return;
+		}
+
+		// ----------| invariant: an upload
+
+		uploaded.push_back(m_);
+		if (m_[kCommand] == TwisterConfig::PUSH_CONF) {
+			globals = m_;
+		} else if (m_[kCommand] == TwisterConfig::BULK_XFER) {
+			records[m_[kSlot]] = m_;
+		}
+	}
+
+	void reply(const std::vector<uint8_t>& m_) {
+		if (!answer || m_.empty())
+			return;
+		RtMidiMessage message;
+		message.assign(m_.data(), m_.size());
+		twister->injectInput(&message, 1);
+	}
+};
+
+// ------------------------------------------------------
+
+void testRoundTrip(const std::string& mfsPath_) {
+	const std::vector<uint8_t> bytes = readFile(mfsPath_);
+	check(!bytes.empty(), "mapping.mfs is readable");
+
+	TwisterConfig config;
+	std::string error;
+	check(config.parse(bytes, &error), "mapping.mfs parses");
+	check(config.encoders.size() == 64, "mapping.mfs has 64 encoder records");
+	check(config.serialize() == bytes, "serialize() gives back the file, byte for byte");
+
+	TwisterConfig again;
+	check(again.parse(config.serialize()), "serialized config parses");
+	check(again.matches(config) && config.matches(again), "parse(serialize()) gives back the same config");
+	check(again.hash() == config.hash(), "round trip keeps the hash");
+
+	// every sysex message carries one record or the globals, and
+	// applying them all rebuilds the config.
+	TwisterConfig fromSysex;
+	for (const auto& m : config.toSysex()) {
+		check(fromSysex.applySysexReply(m), "upload message applies as a reply");
+	}
+	check(fromSysex.matches(config), "upload messages carry the whole config");
+}
+
+// ------------------------------------------------------
+
+void testUpload(const std::string& mfsPath_, const std::string& scratch_) {
+	TwisterConfig config;
+	check(config.load(mfsPath_), "mapping.mfs loads");
+
+	const std::string hashPath = scratch_ + "/test_config.confighash";
+	std::remove(hashPath.c_str());
+
+	RtMidiLoopback::createPort(kPortName, false, true);
+	{
+		DeviceClock clock;
+		TwisterCore twister;
+		clock.twister = &twister;
+
+		twister.setClock(&clock);
+		twister.setConfigHashPath(hashPath);
+		twister.setup(RtMidi::LOOPBACK);
+		RtMidiLoopback::capture(kPortName); // forget what setup sent
+
+		const uint64_t startNs = clock.nowNs();
+		check(twister.uploadConfig(config, true), "upload verifies against the device");
+		check(clock.uploaded == config.toSysex(), "the device received exactly the config's sysex messages");
+		check(clock.pulls == config.encoders.size() + 1, "the upload was read back, globals and every encoder");
+
+		// 65 messages in batches of 8, 20 ms apart, twice - upload
+		// and read-back - and a pause before read-back.
+		const uint64_t tookMs = (clock.nowNs() - startNs) / 1000000;
+		check(tookMs == 2 * 8 * 20 + 20 + 1, "upload is paced on the core's clock");
+
+		// unchanged, so it is skipped.
+		check(twister.uploadConfig(config), "unchanged config is accepted");
+		check(RtMidiLoopback::capture(kPortName).empty(), "unchanged config is not sent again");
+
+		// a device which does not answer: the read-back times out,
+		// on the virtual clock.
+		clock.answer = false;
+		const uint64_t timeoutStartNs = clock.nowNs();
+		check(!twister.uploadConfig(config, true), "upload fails if the device does not answer");
+		const uint64_t waitedMs = (clock.nowNs() - timeoutStartNs) / 1000000;
+		check(waitedMs >= 1000 && waitedMs < 1400, "read-back gives up after its timeout");
+	}
+	RtMidiLoopback::removePort(kPortName);
+	std::remove(hashPath.c_str());
+}
+
+} // close anonymous namespace
+
+// ------------------------------------------------------
+
+int main(int argc, char* argv[]) {
+	if (argc < 3) {
+		std::fprintf(stderr, "usage: %s <mapping.mfs> <scratch directory>\n", argv[0]);
+		return 2;
+	}
+
+	// the failing upload logs an error, as it should.
+	setTwisterLogLevel(TWISTER_LOG_SILENT);
+
+	testRoundTrip(argv[1]);
+	testUpload(argv[1], argv[2]);
+
+	if (gFailures == 0) {
+		std::printf("test_config: ok\n");
+	}
+	return gFailures == 0 ? 0 : 1;
+}
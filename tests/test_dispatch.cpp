@@ -0,0 +1,166 @@
+/*
+
+Tests how input from the twister is decoded and dispatched: encoder
+switches, shifted encoders, bank changes and side buttons, the actions
+bound to them, and what is counted as rejected, ignored or out of
+range.
+
+Messages are injected into a loopback port, and arrive through the
+midi api's delivery thread and the core's callback, as a device's do.
+
+	test_dispatch
+
+*/
+
+#include "TwisterCore.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <tuple>
+
+using namespace pal::Kontrol;
+
+namespace {
+
+const std::string kPortName = "Midi Fighter Twister";
+
+int gFailures = 0;
+
+void check(bool ok_, const char* what_) {
+	if (!ok_) {
+		std::fprintf(stderr, "FAILED: %s\n", what_);
+		++gFailures;
+	}
+}
+
+// ------------------------------------------------------
+
+typedef std::tuple<TwisterEvent::Type, uint8_t, uint8_t> Event; ///< type, id, value
+
+uint64_t arrived(const TwisterStats::Snapshot& s_) {
+	uint64_t n = s_.rejected;
+	for (uint64_t r : s_.received) {
+		n += r;
+	}
+	return n;
+}
+
+// ------------------------------------------------------
+
+void testDispatch() {
+	RtMidiLoopback::createPort(kPortName, false, false);
+	{
+		TwisterCore twister;
+		twister.setup(RtMidi::LOOPBACK);
+
+		// encoder 2 is a switch.
+		TwisterValue rotary0, rotary1, toggle(0.f);
+		twister.setParams({
+			rotary0.param("r0"),
+			rotary1.param("r1"),
+			toggle.param("t", 0.f, 1.f, TwisterParam::Type::BOOL),
+		});
+
+		std::vector<Event> events;
+		twister.setEventHandler([&](const TwisterEvent& e_) {
+			events.emplace_back(e_.type, e_.id, e_.value);
+		});
+
+		int sidePresses = 0, encoderPresses = 0;
+		twister.bindAction(TwisterEvent::Type::SIDE_BUTTON_PRESS, 3, [&]() { ++sidePresses; });
+		twister.bindAction(TwisterEvent::Type::ENCODER_PRESS, 40, [&]() { ++encoderPresses; });
+
+		twister.resetStats();
+
+		const std::vector<std::vector<unsigned char>> input = {
+			{ 0xB1, 2, 127 },   // encoder 2 pressed
+			{ 0xB1, 2, 0 },     // ... and released
+			{ 0xB1, 40, 127 },  // encoder 40, in bank 3, pressed
+			{ 0xB1, 64, 127 },  // switch beyond encoder 63
+			{ 0xB4, 5, 65 },    // encoder 5 turned with shift held
+			{ 0xB4, 70, 65 },   // shifted encoder beyond 63
+			{ 0xB3, 1, 127 },   // bank 1 selected
+			{ 0xB3, 1, 0 },     // ... which the twister follows with a release
+			{ 0xB3, 11, 127 },  // side button 3 pressed
+			{ 0xB3, 11, 0 },    // ... and released
+			{ 0xB3, 40, 127 },  // system controller which is neither
+			{ 0xB0, 20, 64 },   // rotary beyond the first bank
+			{ 0xB2, 0, 16 },    // animation channel, output only
+			{ 0xB5, 0, 16 },    // ring animation channel, output only
+			{ 0x90, 60, 64 },   // note on
+			{ 0xB0, 0x80, 0 },  // controller number out of 7 bits
+		};
+		for (const auto& m : input) {
+			check(RtMidiLoopback::inject(kPortName, m), "message is injected");
+		}
+
+		// wait for the delivery thread, in real time.
+		for (int i = 0; i < 1000 && arrived(twister.getStats()) < input.size(); ++i) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		check(arrived(twister.getStats()) == input.size(), "every message arrives");
+		twister.update();
+
+		const std::vector<Event> expected = {
+			Event(TwisterEvent::Type::ENCODER_PRESS,       2,  127),
+			Event(TwisterEvent::Type::ENCODER_RELEASE,     2,  0),
+			Event(TwisterEvent::Type::ENCODER_PRESS,       40, 127),
+			Event(TwisterEvent::Type::SHIFT_ROTATE,        5,  65),
+			Event(TwisterEvent::Type::BANK_CHANGE,         1,  127),
+			Event(TwisterEvent::Type::SIDE_BUTTON_PRESS,   3,  127),
+			Event(TwisterEvent::Type::SIDE_BUTTON_RELEASE, 3,  0),
+		};
+		check(events == expected, "input decodes to the expected events, in order");
+
+		check(sidePresses == 1, "an action bound to a side button runs on its press");
+		check(encoderPresses == 1, "an action bound to an encoder beyond the first bank runs");
+
+		const TwisterStats::Snapshot stats = twister.getStats();
+		check(stats.rejected == 2, "malformed and non-controller messages are rejected");
+		check(stats.received[1] == 4 && stats.received[3] == 5 && stats.received[4] == 2, "received messages are counted per channel");
+		check(stats.outOfRange == 4, "switch, shift, system and rotary input beyond range is counted");
+		check(stats.ignored == 2, "output-only channels are ignored");
+		check(stats.dispatched == 12, "the rest is dispatched");
+	}
+	RtMidiLoopback::removePort(kPortName);
+}
+
+// ------------------------------------------------------
+
+// the switch toggles its bool parameter, press by press.
+void testSwitchParameter() {
+	RtMidiLoopback::createPort(kPortName, false, false);
+	{
+		TwisterCore twister;
+		twister.setup(RtMidi::LOOPBACK);
+
+		TwisterValue toggle(0.f);
+		twister.setParams({ toggle.param("t", 0.f, 1.f, TwisterParam::Type::BOOL) });
+
+		RtMidiMessage press;
+		const uint8_t bytes[3] = { 0xB1, 0, 127 };
+		press.assign(bytes, sizeof(bytes));
+
+		twister.injectInput(&press, 1);
+		twister.update();
+		check(toggle.get() == 1.f, "a switch press sets its bool parameter");
+	}
+	RtMidiLoopback::removePort(kPortName);
+}
+
+} // close anonymous namespace
+
+// ------------------------------------------------------
+
+int main() {
+	setTwisterLogLevel(TWISTER_LOG_WARNING);
+
+	testDispatch();
+	testSwitchParameter();
+
+	if (gFailures == 0) {
+		std::printf("test_dispatch: ok\n");
+	}
+	return gFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,291 @@
+/*
+
+Tests the loopback midi api on its own, below the core: that its
+ports enumerate in the order they were created, that messages arrive
+in the order they were injected or sent, that sysex passes through
+whole - or not at all, if ignored - and that cancelling the callback,
+closing the port, or removing it stops delivery as it should.
+
+Loopback input is delivered on a thread of its own, so whatever a
+test waits for, it waits for in real time.
+
+	test_loopback
+
+*/
+
+#include "RtMidi.h"
+
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+typedef std::vector<unsigned char> Bytes;
+
+int gFailures = 0;
+
+void check(bool ok_, const char* what_) {
+	if (!ok_) {
+		std::fprintf(stderr, "FAILED: %s\n", what_);
+		++gFailures;
+	}
+}
+
+// ------------------------------------------------------
+
+// what arrives at a callback, from the delivery thread.
+struct Received {
+	std::mutex         mutex;
+	std::vector<Bytes> messages;
+
+	size_t size() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return messages.size();
+	}
+
+	std::vector<Bytes> take() {
+		std::lock_guard<std::mutex> lock(mutex);
+		std::vector<Bytes> taken;
+		taken.swap(messages);
+		return taken;
+	}
+};
+
+void onMessage(double, const unsigned char* message_, size_t size_, void* received_) {
+	Received& received = *static_cast<Received*>(received_);
+	std::lock_guard<std::mutex> lock(received.mutex);
+	received.messages.emplace_back(message_, message_ + size_);
+}
+
+// wait until count_ messages have arrived, or a second has passed.
+bool waitFor(Received& received_, size_t count_) {
+	for (int i = 0; i < 1000 && received_.size() < count_; ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return received_.size() >= count_;
+}
+
+// give the delivery thread time to deliver anything it would.
+void settle() {
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+}
+
+std::vector<RtMidiError::Type> gErrors;
+
+void onError(RtMidiError::Type type_, const std::string&) {
+	gErrors.push_back(type_);
+}
+
+Bytes controlChange(unsigned i_) {
+	return { 0xB0, (unsigned char)(i_ & 0x7F), (unsigned char)((i_ >> 7) & 0x7F) };
+}
+
+// ------------------------------------------------------
+
+void testPorts() {
+	RtMidiIn  in(RtMidi::LOOPBACK);
+	RtMidiOut out(RtMidi::LOOPBACK);
+	check(in.getCurrentApi() == RtMidi::LOOPBACK && out.getCurrentApi() == RtMidi::LOOPBACK, "the loopback api is selected");
+	check(in.getPortCount() == 0, "there are no ports until one is created");
+
+	RtMidiLoopback::createPort("A");
+	RtMidiLoopback::createPort("B");
+	RtMidiLoopback::createPort("C");
+	RtMidiLoopback::createPort("B", true); // changes options only
+
+	check(in.getPortCount() == 3 && out.getPortCount() == 3, "ports enumerate for inputs and outputs alike");
+	check(in.getPortName(0) == "A" && in.getPortName(1) == "B" && in.getPortName(2) == "C", "ports enumerate in the order they were created");
+	check(out.getPortName(2) == "C", "outputs see the same port numbers");
+	check(in.getPortName(3).empty(), "an invalid port number has no name");
+
+	RtMidiLoopback::removePort("B");
+	check(in.getPortCount() == 2 && in.getPortName(1) == "C", "removing a port moves the ones after it up");
+
+	// a virtual port is a port like any other.
+	in.openVirtualPort("D");
+	check(in.isPortOpen() && in.getPortCount() == 3 && in.getPortName(2) == "D", "a virtual port is created, and opened");
+	in.closePort();
+
+	// opening a port which does not exist fails.
+	gErrors.clear();
+	in.setErrorCallback(&onError);
+	in.openPort(7);
+	check(!in.isPortOpen() && gErrors.size() == 1 && gErrors[0] == RtMidiError::INVALID_PARAMETER, "an invalid port number does not open");
+
+	RtMidiLoopback::removePort("A");
+	RtMidiLoopback::removePort("C");
+	RtMidiLoopback::removePort("D");
+	check(in.getPortCount() == 0, "all ports are gone");
+}
+
+// ------------------------------------------------------
+
+void testOrder() {
+	RtMidiLoopback::createPort("order", false, true);
+	{
+		// two inputs on one port both receive everything, in order.
+		Received receivedA, receivedB;
+		RtMidiIn inA(RtMidi::LOOPBACK), inB(RtMidi::LOOPBACK);
+		inA.setRawCallback(&onMessage, &receivedA);
+		inB.setRawCallback(&onMessage, &receivedB);
+		inA.openPort(0);
+		inB.openPort(0);
+
+		// fewer than the input ring holds, in one go.
+		const unsigned kCount = 1000;
+		bool injected = true;
+		for (unsigned i = 0; i < kCount; ++i) {
+			injected &= RtMidiLoopback::inject("order", controlChange(i));
+		}
+		check(injected, "every message is injected");
+		check(waitFor(receivedA, kCount) && waitFor(receivedB, kCount), "every message arrives");
+
+		const std::vector<Bytes> a = receivedA.take();
+		const std::vector<Bytes> b = receivedB.take();
+		bool ordered = a.size() == kCount && b == a;
+		for (unsigned i = 0; ordered && i < kCount; ++i) {
+			ordered = (a[i] == controlChange(i));
+		}
+		check(ordered, "messages arrive at every input in the order they were injected");
+
+		// output is captured in the order it was sent, and counted.
+		RtMidiOut out(RtMidi::LOOPBACK);
+		out.openPort(0);
+		for (unsigned i = 0; i < 10; ++i) {
+			const Bytes m = controlChange(i);
+			out.sendMessage(m.data(), m.size());
+		}
+		const std::vector<Bytes> captured = RtMidiLoopback::capture("order");
+		ordered = captured.size() == 10;
+		for (unsigned i = 0; ordered && i < 10; ++i) {
+			ordered = (captured[i] == controlChange(i));
+		}
+		check(ordered, "output is captured in the order it was sent");
+		check(RtMidiLoopback::capture("order").empty(), "capturing forgets what was captured");
+		check(RtMidiLoopback::sentCount("order") == 10 && RtMidiLoopback::sentBytes("order") == 30, "output is counted");
+
+		// without echo, output does not come back.
+		settle();
+		check(receivedA.size() == 0, "output is not echoed unless asked for");
+	}
+	RtMidiLoopback::removePort("order");
+}
+
+// ------------------------------------------------------
+
+void testSysex() {
+	// longer than both the inline storage and a typical driver buffer.
+	Bytes sysex(300);
+	sysex.front() = 0xF0;
+	for (size_t i = 1; i + 1 < sysex.size(); ++i) {
+		sysex[i] = (unsigned char)(i & 0x7F);
+	}
+	sysex.back() = 0xF7;
+
+	RtMidiLoopback::createPort("sysex", true, true);
+	{
+		Received received;
+		RtMidiIn in(RtMidi::LOOPBACK);
+		in.setRawCallback(&onMessage, &received);
+		in.openPort(0);
+
+		// ignored by default, as with the system apis.
+		RtMidiLoopback::inject("sysex", sysex);
+		RtMidiLoopback::inject("sysex", controlChange(1));
+		check(waitFor(received, 1), "input after ignored sysex arrives");
+		settle();
+		std::vector<Bytes> arrived = received.take();
+		check(arrived.size() == 1 && arrived[0] == controlChange(1), "sysex is ignored by default");
+
+		// once asked for, it arrives whole, between its neighbours.
+		in.ignoreTypes(false, true, true);
+		RtMidiLoopback::inject("sysex", controlChange(2));
+		RtMidiLoopback::inject("sysex", sysex);
+		RtMidiLoopback::inject("sysex", controlChange(3));
+		check(waitFor(received, 3), "sysex arrives once it is not ignored");
+		arrived = received.take();
+		check(arrived.size() == 3 && arrived[0] == controlChange(2) && arrived[1] == sysex && arrived[2] == controlChange(3), "sysex arrives whole, and in order");
+
+		// sent sysex is captured whole, and echoed whole.
+		RtMidiOut out(RtMidi::LOOPBACK);
+		out.openPort(0);
+		out.sendMessage(&sysex);
+		const std::vector<Bytes> captured = RtMidiLoopback::capture("sysex");
+		check(captured.size() == 1 && captured[0] == sysex, "sent sysex is captured whole");
+		check(waitFor(received, 1) && received.take()[0] == sysex, "sent sysex is echoed whole");
+	}
+	RtMidiLoopback::removePort("sysex");
+}
+
+// ------------------------------------------------------
+
+void testCancel() {
+	RtMidiLoopback::createPort("cancel", false, false);
+	{
+		Received received;
+		RtMidiIn in(RtMidi::LOOPBACK);
+		in.setRawCallback(&onMessage, &received);
+		in.openPort(0);
+
+		RtMidiLoopback::inject("cancel", controlChange(1));
+		check(waitFor(received, 1), "input arrives at the callback");
+
+		// with the callback cancelled, input waits in the queue.
+		in.cancelCallback();
+		RtMidiLoopback::inject("cancel", controlChange(2));
+		RtMidiLoopback::inject("cancel", controlChange(3));
+		settle();
+		check(received.size() == 1, "a cancelled callback is not called again");
+
+		Bytes message;
+		in.getMessage(&message);
+		check(message == controlChange(2), "input waits in the queue once the callback is cancelled");
+		in.getMessage(&message);
+		check(message == controlChange(3), "queued input comes out in order");
+		in.getMessage(&message);
+		check(message.empty(), "the queue is empty once read");
+
+		// a closed port receives nothing.
+		in.closePort();
+		check(!in.isPortOpen(), "the port closes");
+		check(RtMidiLoopback::inject("cancel", controlChange(4)), "input to a port nobody listens to is fine");
+		in.openPort(0);
+		settle();
+		in.getMessage(&message);
+		check(message.empty(), "a closed port receives nothing");
+
+		// nor does a removed one, whether or not it was open.
+		RtMidiLoopback::removePort("cancel");
+		check(!RtMidiLoopback::inject("cancel", controlChange(5)), "a removed port refuses input");
+		settle();
+		in.getMessage(&message);
+		check(message.empty(), "a removed port delivers nothing");
+
+		// sending to a removed port goes nowhere.
+		RtMidiOut out(RtMidi::LOOPBACK);
+		RtMidiLoopback::createPort("cancel", false, true);
+		out.openPort(0);
+		RtMidiLoopback::removePort("cancel");
+		out.sendMessage(controlChange(6).data(), 3);
+		check(RtMidiLoopback::capture("cancel").empty(), "output to a removed port is not captured");
+	}
+}
+
+} // close anonymous namespace
+
+// ------------------------------------------------------
+
+int main() {
+	testPorts();
+	testOrder();
+	testSysex();
+	testCancel();
+
+	if (gFailures == 0) {
+		std::printf("test_loopback: ok\n");
+	}
+	return gFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,247 @@
+/*
+
+Tests RtMidi's input queue and the messages it holds: that the
+lock-free ring keeps order as it wraps around, that a full queue
+refuses what does not fit - whole batches included - so that callers
+can count what was dropped, and that messages longer than their
+inline storage survive assignment, appending, copying and the queue.
+
+	test_midi_queue
+
+*/
+
+#include "RtMidi.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+namespace {
+
+typedef std::vector<unsigned char> Bytes;
+typedef MidiInApi::MidiQueue        MidiQueue;
+
+int gFailures = 0;
+
+void check(bool ok_, const char* what_) {
+	if (!ok_) {
+		std::fprintf(stderr, "FAILED: %s\n", what_);
+		++gFailures;
+	}
+}
+
+// ------------------------------------------------------
+
+RtMidiMessage message(const Bytes& bytes_, uint64_t timeNs_ = 0) {
+	RtMidiMessage m;
+	m.assign(bytes_.data(), unsigned(bytes_.size()));
+	m.timeNs    = timeNs_;
+	m.timeStamp = timeNs_ * 1e-9;
+	return m;
+}
+
+Bytes bytes(const RtMidiMessage& m_) {
+	return Bytes(m_.data(), m_.data() + m_.size());
+}
+
+Bytes controlChange(unsigned i_) {
+	return { 0xB0, (unsigned char)(i_ & 0x7F), (unsigned char)((i_ >> 7) & 0x7F) };
+}
+
+Bytes sysex(size_t size_, unsigned char fill_) {
+	Bytes s(size_, fill_);
+	s.front() = 0xF0;
+	s.back()  = 0xF7;
+	return s;
+}
+
+// a queue for limit_ messages, as MidiInApi sets it up.
+struct Queue : MidiQueue {
+	explicit Queue(unsigned limit_) {
+		ringSize = limit_ + 1;
+		ring     = new RtMidiMessage[ringSize];
+	}
+	~Queue() {
+		delete[] ring;
+	}
+};
+
+// ------------------------------------------------------
+
+void testMessage() {
+	RtMidiMessage m;
+	check(m.size() == 0, "a message starts empty");
+
+	// up to the inline size, and beyond.
+	const Bytes three = controlChange(5);
+	m.assign(three.data(), 3);
+	check(bytes(m) == three, "a three byte message is held inline");
+
+	const Bytes long1 = sysex(40, 0x11);
+	m.assign(long1.data(), unsigned(long1.size()));
+	check(bytes(m) == long1 && m.back() == 0xF7, "a message longer than its inline storage is held whole");
+
+	// back to short, after having been long.
+	m.assign(three.data(), 3);
+	check(bytes(m) == three, "a short message after a long one is held whole");
+
+	// appending across the inline boundary.
+	RtMidiMessage grown;
+	for (unsigned char b : long1) {
+		grown.push_back(b);
+	}
+	check(bytes(grown) == long1, "appending byte by byte grows past the inline storage");
+
+	// copies own their bytes, views do not.
+	Bytes viewed = sysex(20, 0x22);
+	RtMidiMessage view;
+	view.view(viewed.data(), unsigned(viewed.size()));
+	check(view.data() == viewed.data(), "a view does not copy");
+	RtMidiMessage copy(view);
+	RtMidiMessage assigned;
+	assigned = view;
+	const Bytes expected = viewed;
+	viewed[1] = 0x33;
+	check(bytes(copy) == expected && bytes(assigned) == expected, "copying a view makes an owning copy");
+
+	const unsigned char tail = 0x44;
+	view.append(&tail, 1);
+	viewed[2] = 0x55;
+	check(view.data() != viewed.data() && view.size() == 21 && view.data()[2] == 0x22 && view.back() == 0x44, "appending to a view makes it an owning copy first");
+
+	m.clear();
+	check(m.size() == 0, "clearing empties a message");
+}
+
+// ------------------------------------------------------
+
+void testWraparound() {
+	// a small ring, so that it wraps around often.
+	Queue queue(5);
+	check(queue.size() == 0, "a queue starts empty");
+
+	Bytes popped;
+	double timeStamp = 0.0;
+	uint64_t timeNs = 0;
+	bool ordered = true;
+	unsigned next = 0, expected = 0;
+
+	// interleave pushes and pops of uneven sizes, so that front and
+	// back pass the end of the ring at different times. every fourth
+	// message is long, so that short ones land in slots which held
+	// long ones before, and the other way round.
+	auto content = [](unsigned i_) { return i_ % 4 == 3 ? sysex(8 + i_ % 50, (unsigned char)(i_ & 0x7F)) : controlChange(i_); };
+	for (unsigned round = 0; round < 200; ++round) {
+		const unsigned pushes = 1 + round % 4;
+		for (unsigned i = 0; i < pushes; ++i) {
+			if (queue.push(message(content(next), next))) {
+				++next;
+			}
+		}
+		const unsigned pops = 1 + (round + 2) % 3;
+		for (unsigned i = 0; i < pops && queue.pop(&popped, &timeStamp, &timeNs); ++i) {
+			ordered &= (popped == content(expected) && timeNs == expected && timeStamp == expected * 1e-9);
+			++expected;
+		}
+	}
+	while (queue.pop(&popped, &timeStamp, &timeNs)) {
+		ordered &= (popped == content(expected) && timeNs == expected);
+		++expected;
+	}
+	check(next > 100, "the ring wrapped around many times");
+	check(ordered && expected == next, "messages come out whole, and in order, as the ring wraps around");
+	check(queue.size() == 0 && !queue.pop(&popped, &timeStamp), "a drained queue is empty");
+}
+
+// ------------------------------------------------------
+
+void testFull() {
+	Queue queue(4);
+
+	// one at a time: the fifth and sixth messages are refused.
+	unsigned dropped = 0;
+	for (unsigned i = 0; i < 6; ++i) {
+		dropped += queue.push(message(controlChange(i))) ? 0 : 1;
+	}
+	check(queue.size() == 4, "a queue holds as many messages as its limit");
+	check(dropped == 2, "messages which do not fit are refused, one by one");
+
+	// a batch: only what fits goes in, and the rest can be counted.
+	Bytes popped;
+	double timeStamp = 0.0;
+	queue.pop(&popped, &timeStamp);
+	queue.pop(&popped, &timeStamp);
+	check(popped == controlChange(1), "refused messages leave the queue as it was");
+
+	std::vector<RtMidiMessage> batch;
+	for (unsigned i = 10; i < 15; ++i) {
+		batch.push_back(message(controlChange(i)));
+	}
+	const unsigned pushed = queue.push(batch.data(), unsigned(batch.size()));
+	check(pushed == 2 && batch.size() - pushed == 3, "a batch is pushed as far as it fits");
+
+	const Bytes expected[] = { controlChange(2), controlChange(3), controlChange(10), controlChange(11) };
+	bool whole = true;
+	for (const Bytes& e : expected) {
+		whole &= queue.pop(&popped, &timeStamp) && popped == e;
+	}
+	check(whole && queue.size() == 0, "a partly pushed batch keeps its first messages, in order");
+}
+
+// ------------------------------------------------------
+
+// the queue as seen through RtMidiIn, without a callback: input beyond
+// its limit is dropped, and what was queued comes out whole.
+void testInput() {
+	RtMidiLoopback::createPort("queue", false, false);
+	{
+		RtMidiIn in(RtMidi::LOOPBACK, "test_midi_queue", 4);
+		in.ignoreTypes(false, true, true);
+		in.openPort(0);
+
+		const Bytes long1 = sysex(100, 0x66);
+		RtMidiLoopback::inject("queue", controlChange(1));
+		RtMidiLoopback::inject("queue", long1);
+		RtMidiLoopback::inject("queue", controlChange(2));
+		RtMidiLoopback::inject("queue", controlChange(3));
+		RtMidiLoopback::inject("queue", controlChange(4)); // dropped, with a warning
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+		const Bytes expected[] = { controlChange(1), long1, controlChange(2), controlChange(3) };
+		Bytes popped;
+		bool whole = true;
+		for (const Bytes& e : expected) {
+			in.getMessage(&popped);
+			whole &= (popped == e);
+		}
+		check(whole, "queued input comes out whole, and in order");
+		in.getMessage(&popped);
+		check(popped.empty(), "input beyond the queue's limit is dropped");
+
+		// and once there is room, input is queued again.
+		RtMidiLoopback::inject("queue", controlChange(5));
+		for (int i = 0; i < 1000 && popped.empty(); ++i) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			in.getMessage(&popped);
+		}
+		check(popped == controlChange(5), "a drained queue takes input again");
+	}
+	RtMidiLoopback::removePort("queue");
+}
+
+} // close anonymous namespace
+
+// ------------------------------------------------------
+
+int main() {
+	testMessage();
+	testWraparound();
+	testFull();
+	testInput();
+
+	if (gFailures == 0) {
+		std::printf("test_midi_queue: ok\n");
+	}
+	return gFailures == 0 ? 0 : 1;
+}
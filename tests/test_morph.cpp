@@ -0,0 +1,122 @@
+/*
+
+Tests preset morphs: that while a morph runs, each encoder is sent at
+most one message per update() - however often its parameter changes
+within the frame - and that the morph lands on the preset.
+
+The twister is simulated on the loopback api, on a virtual clock;
+output is counted on the loopback port.
+
+	test_morph
+
+*/
+
+#include "TwisterCore.h"
+
+#include <array>
+#include <cstdio>
+#include <memory>
+
+using namespace pal::Kontrol;
+
+namespace {
+
+const std::string kPortName = "Midi Fighter Twister";
+const size_t      kEncoders = 16;
+
+int gFailures = 0;
+
+void check(bool ok_, const char* what_) {
+	if (!ok_) {
+		std::fprintf(stderr, "FAILED: %s\n", what_);
+		++gFailures;
+	}
+}
+
+// ------------------------------------------------------
+
+void testOneSendPerFrame() {
+	RtMidiLoopback::createPort(kPortName, false, true);
+	{
+		VirtualClock clock;
+		TwisterCore twister;
+		twister.setClock(&clock);
+		twister.setup(RtMidi::LOOPBACK);
+
+		std::vector<std::unique_ptr<TwisterValue>> values;
+		std::vector<TwisterParam> params;
+		for (size_t i = 0; i < kEncoders; ++i) {
+			values.emplace_back(new TwisterValue(0.f));
+			params.push_back(values.back()->param("p" + std::to_string(i)));
+		}
+
+		// p1 drags p0 along, so that p0 changes twice per frame.
+		TwisterValue& v0 = *values[0];
+		auto set1 = params[1].set;
+		params[1].set = [set1, &v0](float v_) {
+			set1(v_);
+			v0.set(v_);
+		};
+
+		twister.setParams(params);
+
+		for (auto& v : values) {
+			v->set(1.f);
+		}
+		twister.storePreset("full");
+		for (auto& v : values) {
+			v->set(0.f);
+		}
+		RtMidiLoopback::capture(kPortName); // forget what binding sent
+
+		check(twister.recallPreset("full", 100), "preset recalls");
+
+		// ten frames, 10 ms apart.
+		int frames = 0;
+		while (twister.isMorphing() && frames < 20) {
+			clock.advanceMs(10);
+			twister.update();
+			++frames;
+
+			std::array<int, kEncoders> sends{};
+			size_t others = 0;
+			for (const auto& m : RtMidiLoopback::capture(kPortName)) {
+				if (m.size() == 3 && m[0] == 0xB0 && m[1] < kEncoders) {
+					++sends[m[1]];
+				} else {
+					++others;
+				}
+			}
+
+			bool once = true;
+			for (int n : sends) {
+				once &= (n == 1);
+			}
+			check(once, "each encoder is sent its value once per frame");
+			check(others == 0, "a morph sends nothing but values");
+		}
+
+		check(frames == 10, "the morph takes its time, on the core's clock");
+		bool landed = true;
+		for (auto& v : values) {
+			landed &= (v->get() == 1.f);
+		}
+		check(landed, "the morph lands on the preset");
+	}
+	RtMidiLoopback::removePort(kPortName);
+}
+
+} // close anonymous namespace
+
+// ------------------------------------------------------
+
+int main() {
+	setTwisterLogLevel(TWISTER_LOG_WARNING);
+
+	testOneSendPerFrame();
+
+	if (gFailures == 0) {
+		std::printf("test_morph: ok\n");
+	}
+	return gFailures == 0 ? 0 : 1;
+}
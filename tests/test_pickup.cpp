@@ -0,0 +1,147 @@
+/*
+
+Tests pickup (soft-takeover): that a knob which does not stand where
+its parameter does is ignored until it crosses the parameter's value,
+that it then takes over, and that binding the parameter again - as a
+page switch does - waits for the knob afresh.
+
+The twister is simulated on the loopback api, on a virtual clock.
+Input goes through the core's midi callback; output is captured from
+the loopback port.
+
+	test_pickup
+
+*/
+
+#include "TwisterCore.h"
+
+#include <cstdio>
+#include <memory>
+
+using namespace pal::Kontrol;
+
+namespace {
+
+const std::string kPortName = "Midi Fighter Twister";
+
+int gFailures = 0;
+
+void check(bool ok_, const char* what_) {
+	if (!ok_) {
+		std::fprintf(stderr, "FAILED: %s\n", what_);
+		++gFailures;
+	}
+}
+
+// ------------------------------------------------------
+
+// the knob of encoder 0 turned to v_, applied in one update().
+void turn(TwisterCore& twister_, uint8_t v_) {
+	RtMidiMessage message;
+	const uint8_t bytes[3] = { 0xB0, 0, v_ };
+	message.assign(bytes, sizeof(bytes));
+	twister_.injectInput(&message, 1);
+	twister_.update();
+}
+
+// ------------------------------------------------------
+
+// whether the twister was sent a value for encoder 0's ring, and
+// a brightness (animation channel) message for it.
+struct Sent {
+	bool value      = false;
+	bool brightness = false;
+};
+
+Sent captured() {
+	Sent sent;
+	for (const auto& m : RtMidiLoopback::capture(kPortName)) {
+		if (m.size() == 3 && m[1] == 0) {
+			sent.value      |= (m[0] == 0xB0);
+			sent.brightness |= (m[0] == 0xB2);
+		}
+	}
+	return sent;
+}
+
+// ------------------------------------------------------
+
+void testPickup() {
+	RtMidiLoopback::createPort(kPortName, false, true);
+	{
+		VirtualClock clock;
+		TwisterCore twister;
+		twister.setClock(&clock);
+		twister.setup(RtMidi::LOOPBACK);
+
+		// 17 parameters, so that there is a second page to switch to.
+		std::vector<std::unique_ptr<TwisterValue>> values;
+		std::vector<TwisterParam> params;
+		for (int i = 0; i < 17; ++i) {
+			values.emplace_back(new TwisterValue(0.75f));
+			params.push_back(values.back()->param("p" + std::to_string(i)));
+		}
+		TwisterValue& value = *values[0];
+
+		twister.setPickupMode("p0", true);
+		twister.setParams(params);
+		captured(); // forget what binding sent
+
+		const float bound = value.get();
+		const auto ignoredBefore = twister.getStats().ignored;
+
+		// 0.75 shows as 95: the knob, at 20 and 40, has not reached it.
+		turn(twister, 20);
+		Sent sent = captured();
+		turn(twister, 40);
+		check(value.get() == bound, "the parameter does not jump to the knob");
+		check(twister.getStats().ignored == ignoredBefore + 2, "input before pickup is counted as ignored");
+		check(!sent.value, "no value is sent back while waiting for pickup");
+		check(sent.brightness, "the gap to the parameter shows while waiting for pickup");
+
+		// crossing 95, between 40 and 100, picks the parameter up.
+		turn(twister, 100);
+		check(value.get() == ResponseCurve().toNormalised(100), "the knob takes over once it crosses the parameter");
+		turn(twister, 101);
+		check(value.get() == ResponseCurve().toNormalised(101), "the knob keeps control once picked up");
+
+		// binding again - here, a change of pickup mode - waits for
+		// the knob again, from wherever the parameter is.
+		value.set(0.2f); // shows as 25
+		twister.setPickupMode("p0", true);
+		turn(twister, 10);
+		check(value.get() == 0.2f, "binding again waits for pickup again");
+
+		// a page switch binds again, too, and forgets where the knob
+		// was: 10 to 110 would have crossed 25.
+		twister.nextPage();
+		twister.previousPage();
+		turn(twister, 110);
+		check(value.get() == 0.2f, "binding again forgets earlier input");
+
+		// close to the parameter's value counts as crossing it.
+		turn(twister, 26);
+		check(value.get() == ResponseCurve().toNormalised(26), "the knob takes over next to the parameter's value");
+
+		// without pickup, the knob takes over at once.
+		twister.setPickupMode("p0", false);
+		turn(twister, 5);
+		check(value.get() == ResponseCurve().toNormalised(5), "without pickup, the knob takes over at once");
+	}
+	RtMidiLoopback::removePort(kPortName);
+}
+
+} // close anonymous namespace
+
+// ------------------------------------------------------
+
+int main() {
+	setTwisterLogLevel(TWISTER_LOG_WARNING);
+
+	testPickup();
+
+	if (gFailures == 0) {
+		std::printf("test_pickup: ok\n");
+	}
+	return gFailures == 0 ? 0 : 1;
+}
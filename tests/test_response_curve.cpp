@@ -0,0 +1,124 @@
+/*
+
+Tests response curves: that every curve's table is monotonic, and
+that every midi value survives the way to a normalised value and
+back - which is what lets a parameter written back to the twister
+land on the step that produced it.
+
+	test_response_curve
+
+*/
+
+#include "ResponseCurve.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace pal::Kontrol;
+
+namespace {
+
+int gFailures = 0;
+
+void check(bool ok_, const std::string& what_) {
+	if (!ok_) {
+		std::fprintf(stderr, "FAILED: %s\n", what_.c_str());
+		++gFailures;
+	}
+}
+
+// ------------------------------------------------------
+
+struct NamedCurve {
+	std::string   name;
+	ResponseCurve curve;
+};
+
+std::vector<NamedCurve> curves() {
+	// strictly increasing, but uneven.
+	ResponseCurve::Table steps;
+	for (size_t i = 0; i < ResponseCurve::kNumSteps; ++i) {
+		const float t = float(i) / float(ResponseCurve::kNumSteps - 1);
+		steps[i] = t * t * t;
+	}
+
+	return {
+		{ "linear",          ResponseCurve::linear() },
+		{ "default",         ResponseCurve() },
+		{ "logarithmic",     ResponseCurve::logarithmic() },
+		{ "logarithmic(1)",  ResponseCurve::logarithmic(1.f) },
+		{ "logarithmic(50)", ResponseCurve::logarithmic(50.f) },
+		{ "exponential",     ResponseCurve::exponential() },
+		{ "exponential(1)",  ResponseCurve::exponential(1.f) },
+		{ "exponential(12)", ResponseCurve::exponential(12.f) },
+		{ "power",           ResponseCurve::power() },
+		{ "power(0.5)",      ResponseCurve::power(0.5f) },
+		{ "power(4)",        ResponseCurve::power(4.f) },
+		{ "sCurve",          ResponseCurve::sCurve() },
+		{ "sCurve(2)",       ResponseCurve::sCurve(2.f) },
+		{ "sCurve(16)",      ResponseCurve::sCurve(16.f) },
+		{ "table",           ResponseCurve::table(steps) },
+	};
+}
+
+// ------------------------------------------------------
+
+void testCurve(const NamedCurve& c_) {
+	const ResponseCurve& curve = c_.curve;
+
+	check(curve.toNormalised(0) == 0.f && curve.toNormalised(127) == 1.f, c_.name + ": spans 0..1");
+
+	for (unsigned v = 1; v < ResponseCurve::kNumSteps; ++v) {
+		if (curve.toNormalised(uint8_t(v)) < curve.toNormalised(uint8_t(v - 1))) {
+			check(false, c_.name + ": is monotonic, at " + std::to_string(v));
+			break;
+		}
+	}
+
+	for (unsigned v = 0; v < ResponseCurve::kNumSteps; ++v) {
+		if (curve.toMidi(curve.toNormalised(uint8_t(v))) != v) {
+			check(false, c_.name + ": toMidi(toNormalised(v)) == v, at " + std::to_string(v));
+			break;
+		}
+	}
+}
+
+// ------------------------------------------------------
+
+// a table which is neither clamped nor monotonic gets made so; where
+// steps share a value, the round trip lands on a step with that value.
+void testUserTable() {
+	ResponseCurve::Table table;
+	for (size_t i = 0; i < ResponseCurve::kNumSteps; ++i) {
+		table[i] = float(i % 32) / 16.f - 0.5f;
+	}
+	const ResponseCurve curve = ResponseCurve::table(table);
+
+	check(curve.getType() == ResponseCurve::Type::TABLE, "user table: has type TABLE");
+	for (unsigned v = 0; v < ResponseCurve::kNumSteps; ++v) {
+		const float n = curve.toNormalised(uint8_t(v));
+		check(n >= 0.f && n <= 1.f, "user table: is clamped to 0..1");
+		check(v == 0 || n >= curve.toNormalised(uint8_t(v - 1)), "user table: is made monotonic");
+		check(curve.toNormalised(curve.toMidi(n)) == n, "user table: round trip lands on a step of the same value");
+	}
+
+	// out of range values land on the ends.
+	check(curve.toMidi(-1.f) == 0 && curve.toMidi(2.f) == 127, "out of range values land on the ends");
+}
+
+} // close anonymous namespace
+
+// ------------------------------------------------------
+
+int main() {
+	for (const auto& c : curves()) {
+		testCurve(c);
+	}
+	testUserTable();
+
+	if (gFailures == 0) {
+		std::printf("test_response_curve: ok\n");
+	}
+	return gFailures == 0 ? 0 : 1;
+}
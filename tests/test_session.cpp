@@ -0,0 +1,187 @@
+/*
+
+Tests session files: that appending to a session which a crash cut
+short overwrites the partial record with padding, so that none of
+its bytes replay, and that a replay restarted from within its own
+dispatch starts from its first record.
+
+	test_session <scratch directory>
+
+*/
+
+#include "TwisterCore.h"
+
+#include <cstdio>
+#include <cstring>
+
+using namespace pal::Kontrol;
+
+namespace {
+
+const uint64_t kMs = 1000000;
+
+int gFailures = 0;
+
+void check(bool ok_, const char* what_) {
+	if (!ok_) {
+		std::fprintf(stderr, "FAILED: %s\n", what_);
+		++gFailures;
+	}
+}
+
+// ------------------------------------------------------
+
+MidiSessionRecord shiftRotate(uint64_t timeNs_, uint8_t encoder_) {
+	MidiSessionRecord r{};
+	r.timeNs          = timeNs_;
+	r.command_channel = 0xB4;
+	r.controller      = encoder_;
+	r.value           = 65;
+	return r;
+}
+
+// ------------------------------------------------------
+
+long fileSize(const std::string& path_) {
+	std::FILE* file = std::fopen(path_.c_str(), "rb");
+	if (file == nullptr)
+		return -1;
+	std::fseek(file, 0, SEEK_END);
+	const long size = std::ftell(file);
+	std::fclose(file);
+	return size;
+}
+
+// ------------------------------------------------------
+
+void testTruncatedTail(const std::string& scratch_) {
+	const std::string path = scratch_ + "/test_session_truncated.twses";
+	std::remove(path.c_str());
+
+	MidiSessionWriter writer;
+	check(writer.open(path, 1000 * kMs), "session opens");
+	const MidiSessionRecord first = shiftRotate(1010 * kMs, 0);
+	writer.append(&first, 1);
+	writer.close();
+
+	// a crash, part way through writing a record for encoder 5: its
+	// time and status byte made it to disk, its value did not.
+	{
+		const MidiSessionRecord lost = shiftRotate(1020 * kMs, 5);
+		std::FILE* file = std::fopen(path.c_str(), "ab");
+		std::fwrite(&lost, 10, 1, file);
+		std::fclose(file);
+	}
+
+	check(writer.open(path, 2000 * kMs), "session with a partial record opens for appending");
+	const MidiSessionRecord second = shiftRotate(2010 * kMs, 1);
+	writer.append(&second, 1);
+	writer.close();
+
+	check(fileSize(path) == 16 + 5 * 16, "records stay aligned");
+
+	std::vector<MidiSessionRecord> records;
+	check(readMidiSession(path, records), "session reads");
+	check(records.size() == 5, "the partial record takes one record");
+	if (records.size() == 5) {
+		const MidiSessionRecord pad{};
+		check(records[0].command_channel == MidiSessionRecord::kSessionStart, "first recording starts with a marker");
+		check(std::memcmp(&records[2], &pad, sizeof(pad)) == 0, "the partial record is overwritten with padding");
+		check(records[3].command_channel == MidiSessionRecord::kSessionStart, "second recording starts with a marker");
+		check(records[4].controller == 1, "second recording follows");
+	}
+
+	// only the two whole records replay.
+	VirtualClock clock;
+	TwisterCore twister;
+	twister.setClock(&clock);
+
+	std::vector<uint8_t> ids;
+	twister.setEventHandler([&](const TwisterEvent& e_) {
+		ids.push_back(e_.id);
+	});
+
+	check(twister.startReplay(path, false), "session replays");
+	twister.update();
+	check(ids == std::vector<uint8_t>({ 0, 1 }), "nothing of the partial record replays");
+
+	std::remove(path.c_str());
+}
+
+// ------------------------------------------------------
+
+void testRestartFromAction(const std::string& scratch_) {
+	const std::string path = scratch_ + "/test_session_restart.twses";
+	std::remove(path.c_str());
+
+	// more records than fit in one batch, so that the replay
+	// dispatches part way through. written as before start markers
+	// existed, so that the first record is a message.
+	const size_t count = MidiCCBatch::kCapacity + 2;
+	{
+		std::FILE* file = std::fopen(path.c_str(), "wb");
+		const uint32_t format[2] = { MidiSessionWriter::kVersion, uint32_t(sizeof(MidiSessionRecord)) };
+		std::fwrite(MidiSessionWriter::kMagic, sizeof(MidiSessionWriter::kMagic), 1, file);
+		std::fwrite(format, sizeof(format), 1, file);
+		for (size_t i = 0; i < count; ++i) {
+			const MidiSessionRecord r = shiftRotate((1001 + i) * kMs, uint8_t(i % 64));
+			std::fwrite(&r, sizeof(r), 1, file);
+		}
+		std::fclose(file);
+	}
+
+	VirtualClock clock;
+	TwisterCore twister;
+	twister.setClock(&clock);
+
+	std::vector<uint8_t> ids;
+	twister.setEventHandler([&](const TwisterEvent& e_) {
+		ids.push_back(e_.id);
+	});
+
+	// the first message restarts the replay, once.
+	bool restarted = false;
+	twister.bindAction(TwisterEvent::Type::SHIFT_ROTATE, 0, [&]() {
+		if (!restarted) {
+			restarted = true;
+			check(twister.startReplay(path, false), "session replays again");
+		}
+	});
+
+	check(twister.startReplay(path, false), "session replays");
+	twister.update(); // the first batch, which restarts
+	twister.update(); // the restarted replay, all of it
+
+	std::vector<uint8_t> expected;
+	for (size_t i = 0; i < MidiCCBatch::kCapacity; ++i) {
+		expected.push_back(uint8_t(i));
+	}
+	for (size_t i = 0; i < count; ++i) {
+		expected.push_back(uint8_t(i % 64));
+	}
+	check(ids == expected, "a restarted replay plays from its first record");
+	check(!twister.isReplaying(), "restarted replay ends");
+
+	std::remove(path.c_str());
+}
+
+} // close anonymous namespace
+
+// ------------------------------------------------------
+
+int main(int argc, char* argv[]) {
+	if (argc < 2) {
+		std::fprintf(stderr, "usage: %s <scratch directory>\n", argv[0]);
+		return 2;
+	}
+
+	setTwisterLogLevel(TWISTER_LOG_WARNING);
+
+	testTruncatedTail(argv[1]);
+	testRestartFromAction(argv[1]);
+
+	if (gFailures == 0) {
+		std::printf("test_session: ok\n");
+	}
+	return gFailures == 0 ? 0 : 1;
+}
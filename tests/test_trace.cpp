@@ -0,0 +1,121 @@
+/*
+
+Tests trace export while another thread records: every exported event
+must be whole - never half of one event and half of the one which
+overwrote it in the ring.
+
+	test_trace
+
+*/
+
+#include "TraceRecorder.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace pal::Kontrol;
+
+namespace {
+
+int gFailures = 0;
+
+void check(bool ok_, const char* what_) {
+	if (!ok_) {
+		std::fprintf(stderr, "FAILED: %s\n", what_);
+		++gFailures;
+	}
+}
+
+// ------------------------------------------------------
+
+// the i-th event: name, times and arg all follow from i, so that an
+// event put together from two recorded ones shows.
+const char* kNames[2] = { "even", "odd" };
+
+void recordEvent(TraceRecorder& trace_, uint64_t i_) {
+	trace_.complete(kNames[i_ % 2], i_ * 1000, i_ * 1000 + (i_ % 7) * 1000, uint32_t(i_));
+}
+
+// ------------------------------------------------------
+
+// checks every event in an export against the event its arg names.
+// returns the number of events found.
+size_t checkEvents(const std::string& json_) {
+	size_t found = 0;
+	const std::string key = "{\"name\":\"";
+	for (size_t at = json_.find(key); at != std::string::npos; at = json_.find(key, at + 1)) {
+		const char* p = json_.c_str() + at + key.size();
+		const bool odd = (*p == 'o');
+
+		const char* ts  = std::strstr(p, "\"ts\":");
+		const char* dur = std::strstr(p, "\"dur\":");
+		const char* arg = std::strstr(p, "\"value\":");
+		if (ts == nullptr || dur == nullptr || arg == nullptr) {
+			check(false, "exported events are complete");
+			return found;
+		}
+
+		const uint64_t i = std::strtoull(arg + 8, nullptr, 10);
+		const bool whole = odd == (i % 2 == 1) &&
+			std::strtod(ts + 5, nullptr) == double(i) &&
+			std::strtod(dur + 6, nullptr) == double(i % 7);
+		if (!whole) {
+			check(false, "exported events are whole");
+			return found;
+		}
+		++found;
+	}
+	return found;
+}
+
+// ------------------------------------------------------
+
+void testExportWhileRecording() {
+	// a small ring, so that the recording thread laps it often.
+	TraceRecorder trace(64);
+	trace.setEnabled(true);
+
+	std::atomic<bool>     running{ true };
+	std::atomic<uint64_t> recorded{ 0 };
+	std::thread recorder([&]() {
+		for (uint64_t i = 0; running.load(std::memory_order_relaxed); ++i) {
+			recordEvent(trace, i);
+			recorded.store(i + 1, std::memory_order_relaxed);
+		}
+	});
+
+	// export once the ring is full, and keeps being overwritten.
+	while (recorded.load(std::memory_order_relaxed) < 64) {
+		std::this_thread::yield();
+	}
+
+	size_t found = 0;
+	for (int i = 0; i < 2000 && gFailures == 0; ++i) {
+		std::ostringstream out;
+		trace.writeChromeTrace(out);
+		found += checkEvents(out.str());
+	}
+
+	running = false;
+	recorder.join();
+
+	check(found > 0, "events are exported while recording");
+}
+
+} // close anonymous namespace
+
+// ------------------------------------------------------
+
+int main() {
+	testExportWhileRecording();
+
+	if (gFailures == 0) {
+		std::printf("test_trace: ok\n");
+	}
+	return gFailures == 0 ? 0 : 1;
+}